@@ -0,0 +1,208 @@
+# Measures what the reflection generators cost to build. Run through the compile_bench target rather than directly.
+#
+# For every size in SIZES, writes a schema whose row definition has that many properties and a dataset with that
+# many rows, then compiles one translation unit per generator with them:
+#
+#   json_schema   define_schema_types from json_schema.cpp
+#   json_schema2  define_schema_types from json_schema2/main.cpp, on top of khct::parse_json
+#   json_schema3  define_schema_types from json_schema3.cpp
+#   json_struct   make_struct_from_json and make_data_from_json from json_format.hpp, through json_struct.cpp
+#
+# Each translation unit includes its generator's source file, so the examples already in there are a fixed cost
+# that's the same at every size. Wall time, peak RSS and object size go to compile_bench.json in OUTPUT_DIR, and
+# the compiler output of anything that fails or times out is kept next to its source. Peak RSS needs GNU time and
+# is null without it.
+#
+# Inputs: CXX, CXX_FLAGS (space separated), SOURCE_DIR, OUTPUT_DIR, SIZES (comma separated) and TIMEOUT (seconds,
+# 0 for none)
+
+cmake_minimum_required(VERSION 3.25)
+
+foreach(var CXX SOURCE_DIR OUTPUT_DIR SIZES)
+   if(NOT DEFINED ${var})
+      message(FATAL_ERROR "compile_bench.cmake needs -D${var}=...")
+   endif()
+endforeach()
+if(NOT DEFINED TIMEOUT)
+   set(TIMEOUT 0)
+endif()
+
+string(REPLACE "," ";" sizes "${SIZES}")
+separate_arguments(flags UNIX_COMMAND "${CXX_FLAGS}")
+list(APPEND flags "-I${SOURCE_DIR}/src" "-I${SOURCE_DIR}/src/json_schema2")
+
+set(gen_dir "${OUTPUT_DIR}/compile_bench")
+file(MAKE_DIRECTORY "${gen_dir}")
+
+find_program(gnu_time NAMES time)
+if(gnu_time)
+   execute_process(
+      COMMAND "${gnu_time}" -f %M -o "${gen_dir}/time_check.txt" "${CMAKE_COMMAND}" -E true
+      RESULT_VARIABLE time_result
+      OUTPUT_QUIET ERROR_QUIET)
+   if(NOT time_result EQUAL 0)
+      set(gnu_time "")
+   endif()
+endif()
+
+include("${CMAKE_CURRENT_LIST_DIR}/generated_inputs.cmake")
+
+# ----------------------------------
+# - Translation units
+# ----------------------------------
+
+# The generated types are used in an exported function or variable so their code ends up in the object file
+
+function(write_json_schema path schema)
+   file(
+      WRITE "${path}"
+      "// Generated by cmake/compile_bench.cmake
+#include \"json_schema.cpp\"
+
+constexpr char compile_bench_schema[]{R\"(${schema})\"};
+
+consteval { define_schema_types<\"bench\", \"bench_\", compile_bench_schema>(); }
+
+json_schema_types<\"bench_row\"> compile_bench_value{};
+")
+endfunction()
+
+function(write_json_schema2 path schema)
+   file(
+      WRITE "${path}"
+      "// Generated by cmake/compile_bench.cmake
+#include \"json_schema2/main.cpp\"
+
+constexpr char compile_bench_schema[]{R\"(${schema})\"};
+
+consteval { define_schema_types<\"bench\", \"bench_\", compile_bench_schema>(); }
+
+json_schema_types<\"bench\"> compile_bench_value{};
+")
+endfunction()
+
+function(write_json_schema3 path schema)
+   file(
+      WRITE "${path}"
+      "// Generated by cmake/compile_bench.cmake
+#include \"json_schema3.cpp\"
+
+constexpr char compile_bench_schema[]{R\"(${schema})\"};
+
+template<fixed_string>
+struct compile_bench_defs;
+
+consteval { define_schema_types<compile_bench_schema>(^^compile_bench_defs, \"bench\"); }
+
+void compile_bench_round_trip(compile_bench_defs<\"bench\">& value, std::string_view in, std::string& out)
+{
+   from_json_into(value, in);
+   to_json(value, out);
+}
+")
+endfunction()
+
+function(write_json_struct path dataset)
+   file(
+      WRITE "${path}"
+      "// Generated by cmake/compile_bench.cmake
+#include \"json_struct.cpp\"
+
+constexpr char compile_bench_dataset[]{R\"(${dataset})\"};
+
+struct compile_bench_row;
+consteval { make_struct_from_json(^^compile_bench_row, compile_bench_dataset); }
+
+constexpr auto compile_bench_data = make_data_from_json<compile_bench_row>(compile_bench_dataset);
+
+const compile_bench_row* compile_bench_rows() { return compile_bench_data.data(); }
+")
+endfunction()
+
+# ----------------------------------
+# - Measuring
+# ----------------------------------
+
+set(results "")
+
+foreach(size ${sizes})
+   make_schema(schema ${size})
+   make_dataset(dataset ${size})
+   foreach(generator json_schema json_schema2 json_schema3 json_struct)
+      set(name "${generator}_${size}")
+      set(source "${gen_dir}/${name}.cpp")
+      set(object "${gen_dir}/${name}.o")
+      set(log "${gen_dir}/${name}.log")
+      set(rss_file "${gen_dir}/${name}.rss")
+      if(generator STREQUAL "json_struct")
+         write_json_struct("${source}" "${dataset}")
+      else()
+         cmake_language(CALL write_${generator} "${source}" "${schema}")
+      endif()
+      file(REMOVE "${object}" "${log}" "${rss_file}")
+
+      set(command "${CXX}" ${flags} -c "${source}" -o "${object}")
+      if(gnu_time)
+         list(PREPEND command "${gnu_time}" -f %M -o "${rss_file}")
+      endif()
+      set(timeout_args "")
+      if(TIMEOUT GREATER 0)
+         set(timeout_args TIMEOUT ${TIMEOUT})
+      endif()
+
+      message(STATUS "compile_bench: ${name}")
+      string(TIMESTAMP start "%s%f" UTC)
+      execute_process(
+         COMMAND ${command}
+         ${timeout_args}
+         RESULT_VARIABLE result
+         OUTPUT_VARIABLE output
+         ERROR_VARIABLE output)
+      string(TIMESTAMP stop "%s%f" UTC)
+      math(EXPR wall_ms "(${stop} - ${start}) / 1000")
+
+      if(result EQUAL 0)
+         set(status "ok")
+         file(SIZE "${object}" object_bytes)
+      else()
+         if(result MATCHES "timeout")
+            set(status "timeout")
+         else()
+            set(status "failed")
+         endif()
+         set(object_bytes "null")
+         file(WRITE "${log}" "${output}")
+      endif()
+
+      set(peak_rss_kib "null")
+      if(EXISTS "${rss_file}")
+         file(STRINGS "${rss_file}" rss_lines REGEX "^[0-9]+$")
+         if(rss_lines)
+            list(GET rss_lines -1 peak_rss_kib)
+         endif()
+      endif()
+
+      message(STATUS "compile_bench: ${name} ${status} in ${wall_ms} ms, peak RSS ${peak_rss_kib} KiB")
+      list(
+         APPEND
+         results
+         "{\"generator\": \"${generator}\", \"size\": ${size}, \"status\": \"${status}\", \"wall_ms\": ${wall_ms}, \
+\"peak_rss_kib\": ${peak_rss_kib}, \"object_bytes\": ${object_bytes}}")
+   endforeach()
+endforeach()
+
+list(JOIN results ",\n    " results)
+string(REPLACE "\\" "\\\\" escaped_cxx "${CXX}")
+string(REPLACE "\\" "\\\\" escaped_flags "${CXX_FLAGS}")
+string(REPLACE "\"" "\\\"" escaped_flags "${escaped_flags}")
+file(
+   WRITE "${OUTPUT_DIR}/compile_bench.json"
+   "{
+  \"compiler\": \"${escaped_cxx}\",
+  \"flags\": \"${escaped_flags}\",
+  \"results\": [
+    ${results}
+  ]
+}
+")
+message(STATUS "compile_bench: report written to ${OUTPUT_DIR}/compile_bench.json")
@@ -0,0 +1,71 @@
+# Synthetic inputs shared by compile_bench.cmake and write_dataset.cmake
+
+# Properties cycle through the schema types, every other one is required
+function(make_schema out count)
+   set(types integer number string boolean)
+   set(properties "")
+   set(required "")
+   math(EXPR last "${count} - 1")
+   foreach(i RANGE ${last})
+      math(EXPR type_index "${i} % 4")
+      list(GET types ${type_index} type)
+      if(i GREATER 0)
+         string(APPEND properties ",\n")
+      endif()
+      string(APPEND properties "            \"p${i}\": {\"type\": \"${type}\"}")
+      math(EXPR even "${i} % 2")
+      if(even EQUAL 0)
+         if(NOT required STREQUAL "")
+            string(APPEND required ", ")
+         endif()
+         string(APPEND required "\"p${i}\"")
+      endif()
+   endforeach()
+   set(${out}
+       "{
+   \"type\": \"object\",
+   \"properties\": {
+      \"rows\": {\"type\": \"array\", \"items\": {\"$ref\": \"#/$defs/row\"}}
+   },
+   \"required\": [\"rows\"],
+   \"$defs\": {
+      \"row\": {
+         \"type\": \"object\",
+         \"required\": [${required}],
+         \"properties\": {
+${properties}
+         }
+      }
+   }
+}"
+       PARENT_SCOPE)
+endfunction()
+
+# Rows go through a chunk at a time, as every append copies the whole string
+function(make_dataset out count)
+   set(rows "")
+   set(chunk "")
+   math(EXPR last "${count} - 1")
+   foreach(i RANGE ${last})
+      math(EXPR x "${i} % 1000")
+      math(EXPR y "(${i} * 7) % 1000 - 500")
+      math(EXPR flags "${i} % 256")
+      if(i GREATER 0)
+         string(APPEND chunk ",\n")
+      endif()
+      string(APPEND chunk "      {\"id\": ${i}, \"x\": ${x}, \"y\": ${y}, \"flags\": ${flags}}")
+      math(EXPR chunk_end "(${i} + 1) % 1000")
+      if(chunk_end EQUAL 0 OR i EQUAL last)
+         string(APPEND rows "${chunk}")
+         set(chunk "")
+      endif()
+   endforeach()
+   set(${out}
+       "{
+   \"format\": {\"id\": \"i64\", \"x\": \"i32\", \"y\": \"i32\", \"flags\": \"u8\"},
+   \"data\": [
+${rows}
+   ]
+}"
+       PARENT_SCOPE)
+endfunction()
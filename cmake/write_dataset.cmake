@@ -0,0 +1,8 @@
+# Writes a dataset of ROWS rows in the format make_struct_from_json and json_pack read to OUTPUT
+
+cmake_minimum_required(VERSION 3.25)
+
+include("${CMAKE_CURRENT_LIST_DIR}/generated_inputs.cmake")
+
+make_dataset(dataset ${ROWS})
+file(WRITE "${OUTPUT}" "${dataset}\n")
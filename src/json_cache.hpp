@@ -0,0 +1,206 @@
+#ifndef JSON_CACHE_HPP
+#define JSON_CACHE_HPP
+
+#include "json_reflect.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Parsed objects kept by the bytes they were parsed from, for traffic where the same documents come in over and
+// over (heartbeats, configs sent with every request). A document is looked up by a 128-bit hash of its bytes, and
+// a hit hands out the object parsed the first time without parsing anything.
+
+namespace impl {
+
+struct hash128 {
+   std::uint64_t low;
+   std::uint64_t high;
+
+   friend constexpr bool operator==(const hash128& lhs, const hash128& rhs) noexcept = default;
+};
+
+// Little-endian, whatever the target, so hashes are the same in constant evaluation and at run time
+constexpr std::uint64_t load_u64(const char* bytes) noexcept
+{
+   std::uint64_t to_ret = 0;
+   if !consteval {
+      if constexpr (std::endian::native == std::endian::little) {
+         std::memcpy(&to_ret, bytes, sizeof(to_ret));
+         return to_ret;
+      }
+   }
+   for (std::size_t i = 0; i < 8; ++i) {
+      to_ret |= std::uint64_t{static_cast<unsigned char>(bytes[i])} << (8 * i);
+   }
+   return to_ret;
+}
+
+// Both halves of the 128-bit product, folded together
+constexpr std::uint64_t fold_multiply(std::uint64_t a, std::uint64_t b) noexcept
+{
+   const auto product = static_cast<unsigned __int128>(a) * b;
+   return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+}
+
+// Two lanes of multiply-and-fold over 16 bytes at a time, in the style of wyhash. Not meant to resist inputs
+// made to collide, so users should still compare the bytes on a match.
+constexpr hash128 hash_bytes(const std::string_view bytes) noexcept
+{
+   constexpr std::uint64_t keys[]{
+      0xa076'1d64'78bd'642f, 0xe703'7ed1'a0b4'28db, 0x8ebc'6af0'9c88'c6e3, 0x5899'65cc'7537'4cc3};
+   std::uint64_t a = keys[0] ^ bytes.size();
+   std::uint64_t b = keys[1];
+   const auto mix = [&](const char* block) {
+      const auto x = load_u64(block);
+      const auto y = load_u64(block + 8);
+      a = fold_multiply(x ^ a, y ^ keys[2]);
+      b = fold_multiply(y ^ b, x ^ keys[3]);
+   };
+   std::size_t i = 0;
+   for (; i + 16 <= bytes.size(); i += 16) {
+      mix(bytes.data() + i);
+   }
+   if (i < bytes.size()) {
+      char tail[16]{};
+      std::ranges::copy(bytes.substr(i), tail);
+      mix(tail);
+   }
+   return {fold_multiply(a ^ keys[0], b ^ keys[1]), fold_multiply(b ^ keys[2], a ^ keys[3])};
+}
+
+} // namespace impl
+
+struct json_cache_options {
+   // Least recently used documents are evicted once either limit is passed
+   std::size_t max_entries = 1024;
+   // Of source text kept for comparison; documents bigger than this are parsed but never cached
+   std::size_t max_bytes = 64 << 20;
+};
+
+// Safe to share between threads. Cached objects must own their data rather than refer to the input, as from_json's
+// do, since the input is gone by the time the object is handed out again.
+template<typename T>
+class json_parse_cache {
+public:
+   explicit json_parse_cache(json_cache_options options = {}) : options_{options} {}
+
+   // The T that input parses to: shared with earlier calls if they had the same bytes, otherwise parse(input),
+   // which is then kept for later ones. A hash match only counts as a hit if the bytes compare equal too.
+   std::shared_ptr<const T> get(const std::string_view input, const auto& parse)
+   {
+      const auto hash = impl::hash_bytes(input);
+      {
+         std::scoped_lock lock{mutex_};
+         if (auto found = find(hash, input)) {
+            hits_ += 1;
+            return found;
+         }
+         misses_ += 1;
+      }
+      // Parsed without holding the lock, so a large document doesn't hold up lookups of others. Threads that miss on
+      // the same document at once each parse it, and the last one's object is the one that's kept.
+      auto value = std::make_shared<const T>(parse(input));
+      std::scoped_lock lock{mutex_};
+      insert(hash, input, value);
+      return value;
+   }
+
+   std::shared_ptr<const T> get(const std::string_view input)
+   {
+      return get(input, [](const std::string_view json) { return from_json<T>(json); });
+   }
+
+   std::size_t hits() const
+   {
+      std::scoped_lock lock{mutex_};
+      return hits_;
+   }
+
+   std::size_t misses() const
+   {
+      std::scoped_lock lock{mutex_};
+      return misses_;
+   }
+
+   std::size_t size() const
+   {
+      std::scoped_lock lock{mutex_};
+      return entries_.size();
+   }
+
+   // Objects already handed out stay valid, as they're shared
+   void clear()
+   {
+      std::scoped_lock lock{mutex_};
+      index_.clear();
+      entries_.clear();
+      bytes_ = 0;
+   }
+
+private:
+   struct entry {
+      impl::hash128 hash;
+      std::string source;
+      std::shared_ptr<const T> value;
+   };
+
+   struct hash128_hasher {
+      std::size_t operator()(const impl::hash128& hash) const noexcept { return hash.low; }
+   };
+
+   // Most recently used first
+   using entry_list = std::list<entry>;
+
+   std::shared_ptr<const T> find(const impl::hash128& hash, const std::string_view input)
+   {
+      const auto found = index_.find(hash);
+      if (found == index_.end() || found->second->source != input) {
+         return nullptr;
+      }
+      entries_.splice(entries_.begin(), entries_, found->second);
+      return found->second->value;
+   }
+
+   void insert(const impl::hash128& hash, const std::string_view input, std::shared_ptr<const T> value)
+   {
+      if (input.size() > options_.max_bytes || options_.max_entries == 0) {
+         return;
+      }
+      // Either the same document, added by another thread since the lookup, or one that collides with it
+      if (const auto found = index_.find(hash); found != index_.end()) {
+         erase(found->second);
+      }
+      entries_.push_front({hash, std::string{input}, std::move(value)});
+      index_.emplace(hash, entries_.begin());
+      bytes_ += input.size();
+      while (entries_.size() > options_.max_entries || bytes_ > options_.max_bytes) {
+         erase(std::prev(entries_.end()));
+      }
+   }
+
+   void erase(typename entry_list::iterator iter)
+   {
+      bytes_ -= iter->source.size();
+      index_.erase(iter->hash);
+      entries_.erase(iter);
+   }
+
+   json_cache_options options_;
+   mutable std::mutex mutex_;
+   entry_list entries_;
+   std::unordered_map<impl::hash128, typename entry_list::iterator, hash128_hasher> index_;
+   std::size_t bytes_ = 0;
+   std::size_t hits_ = 0;
+   std::size_t misses_ = 0;
+};
+
+#endif // JSON_CACHE_HPP
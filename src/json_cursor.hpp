@@ -0,0 +1,252 @@
+#ifndef JSON_CURSOR_HPP
+#define JSON_CURSOR_HPP
+
+#include "json_number.hpp"
+#include "json_parse.hpp"
+#include "json_string.hpp"
+
+#include <charconv>
+#include <concepts>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+
+enum class json_kind {
+   object,
+   array,
+   string,
+   integer,
+   number,
+   boolean,
+   null,
+};
+
+// A position in a JSON document for parsers that consume it directly, without building a json_value
+struct json_cursor {
+   std::string_view json;
+   std::size_t pos = 0;
+
+   constexpr void skip_whitespace() noexcept
+   {
+      while (pos < json.size() && json[pos] == one_of<' ', '\f', '\n', '\r', '\t', '\v'>) {
+         pos += 1;
+      }
+   }
+
+   // Skips whitespace; '\0' at the end of input
+   constexpr char peek() noexcept
+   {
+      skip_whitespace();
+      return pos < json.size() ? json[pos] : '\0';
+   }
+
+   constexpr bool at_end() noexcept { return peek() == '\0'; }
+
+   constexpr bool consume(char c) noexcept
+   {
+      if (peek() == c) {
+         pos += 1;
+         return true;
+      }
+      return false;
+   }
+
+   constexpr void expect(char c)
+   {
+      if (!consume(c)) {
+         throw std::runtime_error{std::string{"expected '"} + c + "' in JSON input"};
+      }
+   }
+
+   constexpr json_kind peek_kind()
+   {
+      switch (peek()) {
+      case '{': return json_kind::object;
+      case '[': return json_kind::array;
+      case '"': return json_kind::string;
+      case 't':
+      case 'f': return json_kind::boolean;
+      case 'n': return json_kind::null;
+      case '-':
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9': {
+         auto end = pos + 1;
+         while (end < json.size() && ((json[end] >= '0' && json[end] <= '9') || json[end] == one_of<'-', '+'>)) {
+            end += 1;
+         }
+         return end < json.size() && json[end] == one_of<'.', 'e', 'E'> ? json_kind::number : json_kind::integer;
+      }
+      default: throw std::runtime_error{"unexpected token"};
+      }
+   }
+
+   // The string as it appears in the input, escape sequences included
+   constexpr std::string_view read_raw_string()
+   {
+      expect('"');
+      const auto start = pos;
+      while (true) {
+         const auto quote = json.find('"', pos);
+         if (quote == std::string_view::npos) {
+            throw std::runtime_error{"unterminated string"};
+         }
+         // Only an odd number of preceding backslashes escapes the quote
+         auto backslashes = quote;
+         while (backslashes > start && json[backslashes - 1] == '\\') {
+            backslashes -= 1;
+         }
+         pos = quote + 1;
+         if ((quote - backslashes) % 2 == 0) {
+            return json.substr(start, quote - start);
+         }
+      }
+   }
+
+   constexpr void read_string(std::string& out)
+   {
+      const auto raw = read_raw_string();
+      out.clear();
+      if (raw.find('\\') == std::string_view::npos) {
+         out.assign(raw);
+      }
+      else {
+         append_unescaped(out, raw);
+      }
+   }
+
+   // Keys are compared far more often than they contain escapes, so only decode when needed
+   constexpr std::string_view read_key(std::string& scratch)
+   {
+      const auto raw = read_raw_string();
+      expect(':');
+      if (raw.find('\\') == std::string_view::npos) {
+         return raw;
+      }
+      scratch.clear();
+      append_unescaped(scratch, raw);
+      return scratch;
+   }
+
+   template<std::integral T>
+   constexpr T read_integer()
+   {
+      skip_whitespace();
+      const auto first = json.data() + pos;
+      const auto last = json.data() + json.size();
+      T value;
+      const auto [rest, ec] = std::from_chars(first, last, value);
+      if (ec != std::errc{}) {
+         throw std::runtime_error{"number parse error"};
+      }
+      if (rest != last && *rest == one_of<'.', 'e', 'E'>) {
+         throw std::runtime_error{"expected an integer"};
+      }
+      pos += static_cast<std::size_t>(rest - first);
+      return value;
+   }
+
+   // Correctly rounded, and unlike std::from_chars usable in constant evaluation
+   constexpr double read_double()
+   {
+      skip_whitespace();
+      const auto [rest, value] = parse_json_number(json.data() + pos, json.data() + json.size());
+      pos = static_cast<std::size_t>(rest - json.data());
+      return std::visit([](auto v) { return static_cast<double>(v); }, value);
+   }
+
+   constexpr bool read_bool()
+   {
+      skip_whitespace();
+      if (json.substr(pos).starts_with("true")) {
+         pos += 4;
+         return true;
+      }
+      else if (json.substr(pos).starts_with("false")) {
+         pos += 5;
+         return false;
+      }
+      throw std::runtime_error{"expected a boolean"};
+   }
+
+   constexpr void read_null()
+   {
+      skip_whitespace();
+      if (!json.substr(pos).starts_with("null")) {
+         throw std::runtime_error{"expected null"};
+      }
+      pos += 4;
+   }
+
+   // Skips over the next value by bracket matching; its contents are only validated as far as needed to find
+   // where it ends
+   constexpr void skip_value()
+   {
+      const auto c = peek();
+      if (c == '"') {
+         read_raw_string();
+      }
+      else if (c == one_of<'{', '['>) {
+         std::size_t depth = 0;
+         do {
+            const auto next = json.find_first_of("\"{}[]", pos);
+            if (next == std::string_view::npos) {
+               throw std::runtime_error{"unexpected end of JSON input"};
+            }
+            pos = next;
+            const auto found = json[next];
+            if (found == '"') {
+               read_raw_string();
+               continue;
+            }
+            depth = found == one_of<'{', '['> ? depth + 1 : depth - 1;
+            pos += 1;
+         } while (depth != 0);
+      }
+      else if (c == '\0') {
+         throw std::runtime_error{"unexpected end of JSON input"};
+      }
+      else {
+         const auto end = json.find_first_of(" \f\n\r\t\v,:]}", pos);
+         pos = end == std::string_view::npos ? json.size() : end;
+      }
+   }
+
+   // Moves into the object at the cursor, past the members before key, to the start of key's value
+   constexpr void seek_member(const std::string_view key)
+   {
+      expect('{');
+      std::string scratch;
+      if (!consume('}')) {
+         do {
+            if (read_key(scratch) == key) {
+               return;
+            }
+            skip_value();
+         } while (consume(','));
+      }
+      throw std::runtime_error{"no matching key found"};
+   }
+
+   // After a member's value, moves past the members after it and the end of the object
+   constexpr void skip_object_rest()
+   {
+      std::string scratch;
+      while (consume(',')) {
+         read_key(scratch);
+         skip_value();
+      }
+      expect('}');
+   }
+};
+
+#endif // JSON_CURSOR_HPP
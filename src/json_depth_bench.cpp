@@ -0,0 +1,151 @@
+#include "json_sax.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <print>
+#include <string>
+
+// Throughput of parse_json_events, which keeps open containers on an explicit stack, against the recursive
+// descent it replaced, for documents from flat to deeply nested
+
+namespace {
+
+// The previous parser, one call per nesting level
+template<json_handler Handler>
+void parse_recursive(structural_index_stream& indexes, Handler& handler)
+{
+   const auto json = indexes.json();
+   const auto peek_char = [&] {
+      const auto pos = indexes.peek();
+      return pos == json.size() ? '\0' : json[pos];
+   };
+   const auto string_at = [&](std::uint32_t open) {
+      const auto close = indexes.next();
+      return json.substr(open + 1, close - open - 1);
+   };
+   const auto start = indexes.next();
+   switch (json[start]) {
+   case '{':
+      handler.on_object_begin();
+      if (peek_char() == '}') {
+         indexes.next();
+         handler.on_object_end();
+         return;
+      }
+      while (true) {
+         handler.on_key(string_at(indexes.next()));
+         indexes.next();
+         parse_recursive(indexes, handler);
+         if (json[indexes.next()] == '}') {
+            handler.on_object_end();
+            return;
+         }
+      }
+   case '[':
+      handler.on_array_begin();
+      if (peek_char() == ']') {
+         indexes.next();
+         handler.on_array_end();
+         return;
+      }
+      while (true) {
+         parse_recursive(indexes, handler);
+         if (json[indexes.next()] == ']') {
+            handler.on_array_end();
+            return;
+         }
+      }
+   case '"': handler.on_string(string_at(start)); return;
+   default: {
+      auto scalar = json.substr(start, indexes.peek() - start);
+      while (!scalar.empty() && impl::is_whitespace(scalar.back())) {
+         scalar.remove_suffix(1);
+      }
+      impl::emit_scalar(handler, scalar);
+      return;
+   }
+   }
+}
+
+struct event_counter {
+   std::size_t events = 0;
+
+   void on_object_begin() { events += 1; }
+   void on_object_end() { events += 1; }
+   void on_array_begin() { events += 1; }
+   void on_array_end() { events += 1; }
+   void on_key(std::string_view) { events += 1; }
+   void on_string(std::string_view) { events += 1; }
+   void on_int64(std::int64_t) { events += 1; }
+   void on_double(double) { events += 1; }
+   void on_bool(bool) { events += 1; }
+   void on_null() { events += 1; }
+};
+
+// An array of num_items values, each nested depth levels deep, alternating objects and arrays
+std::string make_document(std::size_t depth, std::size_t num_items)
+{
+   std::string item;
+   for (std::size_t i = 0; i < depth; ++i) {
+      item += i % 2 == 0 ? R"({"k": )" : "[1, ";
+   }
+   item += R"("leaf")";
+   for (std::size_t i = depth; i > 0; --i) {
+      item += (i - 1) % 2 == 0 ? "}" : "]";
+   }
+   std::string to_ret = "[";
+   for (std::size_t i = 0; i < num_items; ++i) {
+      if (i != 0) {
+         to_ret += ", ";
+      }
+      to_ret += item;
+   }
+   to_ret += "]";
+   return to_ret;
+}
+
+double gb_per_sec(std::size_t bytes, auto from, auto to)
+{
+   return static_cast<double>(bytes) / std::chrono::duration<double>(to - from).count() / 1e9;
+}
+
+} // namespace
+
+int main()
+{
+   constexpr std::size_t target_size = 64 << 20;
+   constexpr std::size_t repeats = 5;
+   std::println("{:>6} {:>14} {:>14}", "depth", "explicit GB/s", "recursive GB/s");
+   for (const std::size_t depth : {1, 4, 16, 64, 256, 1000}) {
+      const auto item_size = make_document(depth, 1).size();
+      const auto document = make_document(depth, std::max<std::size_t>(1, target_size / item_size));
+
+      double explicit_best = 0;
+      double recursive_best = 0;
+      for (std::size_t i = 0; i < repeats; ++i) {
+         event_counter explicit_counter;
+         const auto start = std::chrono::steady_clock::now();
+         parse_json_events(document, explicit_counter, {.max_depth = depth + 1});
+         const auto middle = std::chrono::steady_clock::now();
+         event_counter recursive_counter;
+         auto indexes = structural_index_stream{document};
+         parse_recursive(indexes, recursive_counter);
+         const auto stop = std::chrono::steady_clock::now();
+         assert(explicit_counter.events == recursive_counter.events);
+         explicit_best = std::max(explicit_best, gb_per_sec(document.size(), start, middle));
+         recursive_best = std::max(recursive_best, gb_per_sec(document.size(), middle, stop));
+      }
+      std::println("{:>6} {:>14.2f} {:>14.2f}", depth, explicit_best, recursive_best);
+   }
+
+   // Far past what the recursive version can handle on a default 8 MiB stack
+   constexpr std::size_t very_deep = 1'000'000;
+   const auto deep = std::string(very_deep, '[') + std::string(very_deep, ']');
+   event_counter counter;
+   parse_json_events(deep, counter, {.max_depth = very_deep});
+   assert(counter.events == 2 * very_deep);
+   std::println("{} nested arrays: {} events", very_deep, counter.events);
+}
@@ -0,0 +1,664 @@
+#ifndef JSON_DOM_HPP
+#define JSON_DOM_HPP
+
+#include "json_sax.hpp"
+#include "json_string.hpp"
+#include "json_write.hpp"
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A document that can be changed after it's parsed and written back out. Every value is one 16-byte node:
+//
+//  bytes | contents
+//  ------+---------------------------------------------------------------------------------------------
+//   0-7  | the std::int64_t or double; a string of up to 8 characters; a pointer to a longer string; or the
+//        | indexes of the first and last children of an object or array
+//   8-11 | index of the next value in the same container
+//  12-15 | top 4 bits the kind of value, the rest the length of a string or the number of children
+//
+// Containers are lists of their children, and an object's children are its keys and values in turn, so inserting
+// or erasing a member only relinks its neighbours and never moves the rest. Nodes are taken from chunks that
+// never move and are only given back all at once, so a whole document is freed without visiting its values, and
+// a value that's replaced or erased just stays where it is, unreachable, until then.
+//
+// Strings from the parsed text are views of it, as with parse_json, except where escape sequences had to be
+// decoded; strings set later are copied into the document. Either way, short ones are copied into their node.
+
+namespace impl {
+
+enum class dom_kind : std::uint8_t {
+   null_value,
+   false_value,
+   true_value,
+   int64,
+   double_value,
+   small_string,
+   string,
+   object,
+   array,
+};
+
+inline constexpr std::uint32_t no_node = static_cast<std::uint32_t>(-1);
+inline constexpr std::uint32_t dom_size_max = (std::uint32_t{1} << 28) - 1;
+
+struct dom_node {
+   struct children {
+      std::uint32_t first;
+      std::uint32_t last;
+   };
+
+   union payload_type {
+      std::int64_t integer;
+      double number;
+      std::array<char, 8> small;
+      const char* chars;
+      children list;
+   };
+
+   payload_type payload{.integer = 0};
+   std::uint32_t next = no_node;
+   std::uint32_t kind_and_size = 0;
+
+   constexpr dom_kind kind() const noexcept { return static_cast<dom_kind>(kind_and_size >> 28); }
+   constexpr std::uint32_t size() const noexcept { return kind_and_size & dom_size_max; }
+
+   constexpr std::string_view string() const noexcept
+   {
+      if (kind() == dom_kind::small_string) {
+         return {payload.small.data(), size()};
+      }
+      return {payload.chars, size()};
+   }
+
+   constexpr void set_kind(dom_kind kind, std::size_t size)
+   {
+      if (size > dom_size_max) {
+         throw std::runtime_error{"JSON value too large for json_dom"};
+      }
+      kind_and_size = (static_cast<std::uint32_t>(kind) << 28) | static_cast<std::uint32_t>(size);
+   }
+};
+
+static_assert(sizeof(dom_node) == 16);
+
+} // namespace impl
+
+class json_dom;
+class dom_map;
+class dom_array;
+
+// A handle to a value in a json_dom, valid until the value is replaced or erased or the document is cleared
+class dom_value {
+public:
+   constexpr dom_value(json_dom* dom, std::uint32_t index) noexcept : dom_{dom}, index_{index} {}
+
+   template<typename T>
+   constexpr bool holds() const noexcept;
+
+   constexpr void set(std::int64_t v);
+   // A template so that ints don't convert to it
+   template<std::floating_point Float>
+   constexpr void set(Float v);
+   // A template so that string literals and ints don't convert to bool
+   template<std::same_as<bool> Bool>
+   constexpr void set(Bool v);
+   constexpr void set(std::nullptr_t);
+   // Copied into the document
+   constexpr void set(std::string_view v);
+   // An empty object or array in place of the value
+   constexpr dom_map set_object();
+   constexpr dom_array set_array();
+
+   friend constexpr bool operator==(const dom_value& lhs, const dom_value& rhs) noexcept
+   {
+      return lhs.dom_ == rhs.dom_ && lhs.index_ == rhs.index_;
+   }
+
+private:
+   template<typename T>
+   friend constexpr T get(const dom_value& v);
+
+   friend class dom_map;
+   friend class dom_array;
+
+   constexpr impl::dom_node& node() const;
+
+   json_dom* dom_;
+   std::uint32_t index_;
+};
+
+class json_dom {
+public:
+   // A document holding just null
+   constexpr json_dom() { clear(); }
+
+   // The strings of the result that weren't decoded or short enough to be copied are views of json, which must
+   // outlive it
+   constexpr explicit json_dom(const std::string_view json, parse_options options = {})
+   {
+      clear();
+      builder handler{*this};
+      parse_json_events(json, handler, strings_, options);
+   }
+
+   // Handles refer to the document by address
+   json_dom(const json_dom&) = delete;
+   json_dom& operator=(const json_dom&) = delete;
+
+   constexpr dom_value root() noexcept { return {this, 0}; }
+
+   constexpr std::size_t node_count() const noexcept { return size_; }
+
+   // Makes the document just null again, invalidating every handle and string into it, but keeps the memory
+   constexpr void clear()
+   {
+      size_ = 0;
+      strings_.clear();
+      new_node();
+   }
+
+private:
+   friend class dom_value;
+   friend class dom_map;
+   friend class dom_array;
+
+   static constexpr std::size_t chunk_bits = 12;
+   static constexpr std::size_t chunk_size = std::size_t{1} << chunk_bits;
+
+   // Receives parse_json_events's events and links each value into the container that's open
+   struct builder {
+      json_dom& dom;
+      std::vector<std::uint32_t> open = {};
+
+      constexpr void on_object_begin() { open.push_back(begin(impl::dom_kind::object)); }
+      constexpr void on_array_begin() { open.push_back(begin(impl::dom_kind::array)); }
+      constexpr void on_object_end() { open.pop_back(); }
+      constexpr void on_array_end() { open.pop_back(); }
+
+      constexpr void on_key(const std::string_view key)
+      {
+         const auto index = dom.new_node();
+         dom.set_string(index, key, false);
+         dom.link_last(open.back(), index);
+      }
+
+      constexpr void on_string(const std::string_view v) { dom.set_string(add(), v, false); }
+      constexpr void on_int64(std::int64_t v) { dom_value{&dom, add()}.set(v); }
+      constexpr void on_double(double v) { dom_value{&dom, add()}.set(v); }
+      constexpr void on_bool(bool v) { dom_value{&dom, add()}.set(v); }
+      constexpr void on_null() { add(); }
+
+      // A new null value in the open container, or the root if there isn't one
+      constexpr std::uint32_t add()
+      {
+         if (open.empty()) {
+            return 0;
+         }
+         const auto index = dom.new_node();
+         dom.link_last(open.back(), index);
+         dom.count(open.back(), 1);
+         return index;
+      }
+
+      constexpr std::uint32_t begin(impl::dom_kind kind)
+      {
+         const auto index = add();
+         dom.set_container(index, kind);
+         return index;
+      }
+   };
+
+   constexpr impl::dom_node& node(std::uint32_t index) noexcept
+   {
+      return chunks_[index >> chunk_bits][index & (chunk_size - 1)];
+   }
+
+   constexpr std::uint32_t new_node()
+   {
+      if (size_ == impl::no_node) {
+         throw std::runtime_error{"too many values for json_dom"};
+      }
+      if (size_ >> chunk_bits == chunks_.size()) {
+         chunks_.push_back(std::make_unique<impl::dom_node[]>(chunk_size));
+      }
+      const auto index = static_cast<std::uint32_t>(size_++);
+      node(index) = {};
+      return index;
+   }
+
+   constexpr void set_string(std::uint32_t index, const std::string_view v, bool copy)
+   {
+      auto& n = node(index);
+      if (v.size() <= 8) {
+         std::array<char, 8> small{};
+         std::ranges::copy(v, small.begin());
+         n.set_kind(impl::dom_kind::small_string, v.size());
+         n.payload.small = small;
+         return;
+      }
+      n.set_kind(impl::dom_kind::string, v.size());
+      if (copy) {
+         const auto chars = strings_.allocate(v.size());
+         std::ranges::copy(v, chars);
+         n.payload.chars = chars;
+      }
+      else {
+         n.payload.chars = v.data();
+      }
+   }
+
+   constexpr void set_container(std::uint32_t index, impl::dom_kind kind)
+   {
+      auto& n = node(index);
+      n.set_kind(kind, 0);
+      n.payload.list = {impl::no_node, impl::no_node};
+   }
+
+   constexpr void count(std::uint32_t container, int change)
+   {
+      auto& n = node(container);
+      n.set_kind(n.kind(), static_cast<std::size_t>(static_cast<int>(n.size()) + change));
+   }
+
+   constexpr void link_last(std::uint32_t container, std::uint32_t index)
+   {
+      auto& list = node(container).payload.list;
+      if (list.last == impl::no_node) {
+         list.first = index;
+      }
+      else {
+         node(list.last).next = index;
+      }
+      list.last = index;
+   }
+
+   // Links the run of values from first to last in after prev, or first in the container if prev is no_node
+   constexpr void link_after(std::uint32_t container, std::uint32_t prev, std::uint32_t first, std::uint32_t last)
+   {
+      auto& list = node(container).payload.list;
+      auto& before = prev == impl::no_node ? list.first : node(prev).next;
+      node(last).next = before;
+      before = first;
+      if (list.last == prev) {
+         list.last = last;
+      }
+   }
+
+   // Unlinks the run of values from the one after prev, or the container's first if prev is no_node, to last
+   constexpr void unlink_after(std::uint32_t container, std::uint32_t prev, std::uint32_t last)
+   {
+      auto& list = node(container).payload.list;
+      (prev == impl::no_node ? list.first : node(prev).next) = node(last).next;
+      if (list.last == last) {
+         list.last = prev;
+      }
+   }
+
+   std::vector<std::unique_ptr<impl::dom_node[]>> chunks_;
+   std::size_t size_ = 0;
+   json_string_arena strings_;
+};
+
+constexpr impl::dom_node& dom_value::node() const { return dom_->node(index_); }
+
+template<typename T>
+constexpr bool dom_value::holds() const noexcept
+{
+   const auto kind = node().kind();
+   if constexpr (std::same_as<T, std::int64_t>) {
+      return kind == impl::dom_kind::int64;
+   }
+   else if constexpr (std::same_as<T, double>) {
+      return kind == impl::dom_kind::double_value;
+   }
+   else if constexpr (std::same_as<T, bool>) {
+      return kind == impl::dom_kind::true_value || kind == impl::dom_kind::false_value;
+   }
+   else if constexpr (std::same_as<T, std::nullptr_t>) {
+      return kind == impl::dom_kind::null_value;
+   }
+   else if constexpr (std::same_as<T, std::string_view>) {
+      return kind == impl::dom_kind::small_string || kind == impl::dom_kind::string;
+   }
+   else if constexpr (std::same_as<T, dom_map>) {
+      return kind == impl::dom_kind::object;
+   }
+   else if constexpr (std::same_as<T, dom_array>) {
+      return kind == impl::dom_kind::array;
+   }
+   else {
+      static_assert(false, "not a JSON value type");
+   }
+}
+
+constexpr void dom_value::set(std::int64_t v)
+{
+   node().set_kind(impl::dom_kind::int64, 0);
+   node().payload.integer = v;
+}
+
+template<std::floating_point Float>
+constexpr void dom_value::set(Float v)
+{
+   node().set_kind(impl::dom_kind::double_value, 0);
+   node().payload.number = static_cast<double>(v);
+}
+
+template<std::same_as<bool> Bool>
+constexpr void dom_value::set(Bool v)
+{
+   node().set_kind(v ? impl::dom_kind::true_value : impl::dom_kind::false_value, 0);
+}
+
+constexpr void dom_value::set(std::nullptr_t) { node().set_kind(impl::dom_kind::null_value, 0); }
+
+constexpr void dom_value::set(const std::string_view v) { dom_->set_string(index_, v, true); }
+
+// Forward range over the (key, value) pairs of an object, in document order
+class dom_map {
+public:
+   class iterator {
+   public:
+      using value_type = std::pair<std::string_view, dom_value>;
+      using difference_type = std::ptrdiff_t;
+
+      constexpr iterator() noexcept = default;
+      constexpr iterator(json_dom* dom, std::uint32_t key) noexcept : dom_{dom}, key_{key} {}
+
+      constexpr value_type operator*() const
+      {
+         const auto& key = dom_->node(key_);
+         return {key.string(), dom_value{dom_, key.next}};
+      }
+
+      constexpr iterator& operator++()
+      {
+         key_ = dom_->node(dom_->node(key_).next).next;
+         return *this;
+      }
+
+      constexpr iterator operator++(int)
+      {
+         auto to_ret = *this;
+         ++*this;
+         return to_ret;
+      }
+
+      friend constexpr bool operator==(const iterator& lhs, const iterator& rhs) noexcept
+      {
+         return lhs.key_ == rhs.key_;
+      }
+
+   private:
+      json_dom* dom_ = nullptr;
+      std::uint32_t key_ = impl::no_node;
+   };
+
+   constexpr explicit dom_map(const dom_value& v) noexcept : value_{v} {}
+
+   constexpr iterator begin() const { return {value_.dom_, value_.node().payload.list.first}; }
+   constexpr iterator end() const noexcept { return {value_.dom_, impl::no_node}; }
+
+   constexpr std::size_t size() const { return value_.node().size(); }
+   constexpr bool empty() const { return size() == 0; }
+
+   // The value of key, which is added as null at the end if the object doesn't have it yet
+   constexpr dom_value operator[](const std::string_view key)
+   {
+      if (const auto found = find(key).second; found != impl::no_node) {
+         return value_of(found);
+      }
+      auto& dom = *value_.dom_;
+      const auto key_index = dom.new_node();
+      dom.set_string(key_index, key, true);
+      const auto value_index = dom.new_node();
+      dom.link_last(value_.index_, key_index);
+      dom.link_last(value_.index_, value_index);
+      dom.count(value_.index_, 1);
+      return {value_.dom_, value_index};
+   }
+
+   // Returns whether the object had key
+   constexpr bool erase(const std::string_view key)
+   {
+      const auto [prev, found] = find(key);
+      if (found == impl::no_node) {
+         return false;
+      }
+      value_.dom_->unlink_after(value_.index_, prev, value_.dom_->node(found).next);
+      value_.dom_->count(value_.index_, -1);
+      return true;
+   }
+
+private:
+   friend constexpr std::optional<dom_value> get_by_key_opt(const dom_map vals, const std::string_view key);
+
+   // The key node of the first member named key, if there is one, and the value node before it
+   constexpr std::pair<std::uint32_t, std::uint32_t> find(const std::string_view key) const
+   {
+      auto prev = impl::no_node;
+      for (auto i = value_.node().payload.list.first; i != impl::no_node;) {
+         const auto& key_node = value_.dom_->node(i);
+         if (key_node.string() == key) {
+            return {prev, i};
+         }
+         prev = key_node.next;
+         i = value_.dom_->node(prev).next;
+      }
+      return {prev, impl::no_node};
+   }
+
+   constexpr dom_value value_of(std::uint32_t key) const { return {value_.dom_, value_.dom_->node(key).next}; }
+
+   dom_value value_;
+};
+
+// Forward range over the values of an array
+class dom_array {
+public:
+   class iterator {
+   public:
+      using value_type = dom_value;
+      using difference_type = std::ptrdiff_t;
+
+      constexpr iterator() noexcept = default;
+      constexpr iterator(json_dom* dom, std::uint32_t index) noexcept : dom_{dom}, index_{index} {}
+
+      constexpr value_type operator*() const noexcept { return {dom_, index_}; }
+
+      constexpr iterator& operator++()
+      {
+         index_ = dom_->node(index_).next;
+         return *this;
+      }
+
+      constexpr iterator operator++(int)
+      {
+         auto to_ret = *this;
+         ++*this;
+         return to_ret;
+      }
+
+      friend constexpr bool operator==(const iterator& lhs, const iterator& rhs) noexcept
+      {
+         return lhs.index_ == rhs.index_;
+      }
+
+   private:
+      json_dom* dom_ = nullptr;
+      std::uint32_t index_ = impl::no_node;
+   };
+
+   constexpr explicit dom_array(const dom_value& v) noexcept : value_{v} {}
+
+   constexpr iterator begin() const { return {value_.dom_, value_.node().payload.list.first}; }
+   constexpr iterator end() const noexcept { return {value_.dom_, impl::no_node}; }
+
+   constexpr std::size_t size() const { return value_.node().size(); }
+   constexpr bool empty() const { return size() == 0; }
+
+   // Linear, as elements are a list
+   constexpr dom_value operator[](std::size_t index) const { return {value_.dom_, element_at(index)}; }
+
+   // A new null element at the end
+   constexpr dom_value push_back() { return insert(size()); }
+
+   // A new null element before the one at index
+   constexpr dom_value insert(std::size_t index)
+   {
+      const auto prev = index == 0 ? impl::no_node : element_at(index - 1);
+      const auto element = value_.dom_->new_node();
+      value_.dom_->link_after(value_.index_, prev, element, element);
+      value_.dom_->count(value_.index_, 1);
+      return {value_.dom_, element};
+   }
+
+   constexpr void erase(std::size_t index)
+   {
+      const auto prev = index == 0 ? impl::no_node : element_at(index - 1);
+      const auto& list = value_.node().payload.list;
+      const auto element = prev == impl::no_node ? list.first : value_.dom_->node(prev).next;
+      if (element == impl::no_node) {
+         throw std::runtime_error{"array index out of range"};
+      }
+      value_.dom_->unlink_after(value_.index_, prev, element);
+      value_.dom_->count(value_.index_, -1);
+   }
+
+private:
+   constexpr std::uint32_t element_at(std::size_t index) const
+   {
+      if (index >= size()) {
+         throw std::runtime_error{"array index out of range"};
+      }
+      auto to_ret = value_.node().payload.list.first;
+      for (; index != 0; --index) {
+         to_ret = value_.dom_->node(to_ret).next;
+      }
+      return to_ret;
+   }
+
+   dom_value value_;
+};
+
+constexpr dom_map dom_value::set_object()
+{
+   dom_->set_container(index_, impl::dom_kind::object);
+   return dom_map{*this};
+}
+
+constexpr dom_array dom_value::set_array()
+{
+   dom_->set_container(index_, impl::dom_kind::array);
+   return dom_array{*this};
+}
+
+// Mirrors std::get on json_value, e.g., get<dom_map>(value)
+template<typename T>
+constexpr T get(const dom_value& v)
+{
+   if (!v.holds<T>()) {
+      throw std::runtime_error{"JSON value holds a different type"};
+   }
+   const auto& n = v.node();
+   if constexpr (std::same_as<T, std::int64_t>) {
+      return n.payload.integer;
+   }
+   else if constexpr (std::same_as<T, double>) {
+      return n.payload.number;
+   }
+   else if constexpr (std::same_as<T, bool>) {
+      return n.kind() == impl::dom_kind::true_value;
+   }
+   else if constexpr (std::same_as<T, std::nullptr_t>) {
+      return nullptr;
+   }
+   else if constexpr (std::same_as<T, std::string_view>) {
+      return n.string();
+   }
+   else {
+      return T{v};
+   }
+}
+
+// Taken by value so these are preferred over the json_map overloads in json_parse.hpp
+constexpr std::optional<dom_value> get_by_key_opt(const dom_map vals, const std::string_view key)
+{
+   if (const auto found = vals.find(key).second; found != impl::no_node) {
+      return vals.value_of(found);
+   }
+   return std::nullopt;
+}
+
+constexpr dom_value get_by_key(const dom_map vals, const std::string_view key)
+{
+   if (const auto val = get_by_key_opt(vals, key)) {
+      return *val;
+   }
+   throw std::runtime_error{"no matching key found"};
+}
+
+namespace impl {
+
+template<json_output Out>
+constexpr void write_dom_value(json_writer<Out>& writer, const dom_value& v)
+{
+   if (v.holds<dom_map>()) {
+      writer.begin_object();
+      for (const auto& [key, member] : get<dom_map>(v)) {
+         writer.key(key);
+         write_dom_value(writer, member);
+      }
+      writer.end_object();
+   }
+   else if (v.holds<dom_array>()) {
+      writer.begin_array();
+      for (const auto& element : get<dom_array>(v)) {
+         write_dom_value(writer, element);
+      }
+      writer.end_array();
+   }
+   else if (v.holds<std::string_view>()) {
+      writer.value(get<std::string_view>(v));
+   }
+   else if (v.holds<std::int64_t>()) {
+      writer.value(get<std::int64_t>(v));
+   }
+   else if (v.holds<double>()) {
+      writer.value(get<double>(v));
+   }
+   else if (v.holds<bool>()) {
+      writer.value(get<bool>(v));
+   }
+   else {
+      writer.value(nullptr);
+   }
+}
+
+} // namespace impl
+
+constexpr void write_json(const dom_value& v, json_output auto& out, write_options options = {})
+{
+   json_writer writer{out, options};
+   impl::write_dom_value(writer, v);
+}
+
+constexpr std::string to_json_string(const dom_value& v, write_options options = {})
+{
+   std::string to_ret;
+   write_json(v, to_ret, options);
+   return to_ret;
+}
+
+#endif // JSON_DOM_HPP
@@ -0,0 +1,287 @@
+#ifndef JSON_EDIT_HPP
+#define JSON_EDIT_HPP
+
+#include "json_sax.hpp"
+#include "json_simd.hpp"
+#include "json_tape.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A document that's kept parsed while its text is edited. Along with the tape (see json_tape.hpp) it keeps the
+// source position and the enclosing container of every entry, so an edit is mapped to the innermost container
+// around it with a binary search and a walk up the containers, and only that container's text is parsed again.
+// Its new entries are spliced in over the old ones: entries before it stay as they are and entries after it are
+// only shifted, so an edit costs a parse of the container plus, if the edit changes the length of the text or the
+// number of entries, a pass over the rest of the tape at memory speed rather than a parse of the whole document.
+//
+// The result is always the tape a full parse of the edited text would give. An edit the container can't absorb on
+// its own, like one that closes it and opens another, is tried again on the container around it, and so on up to
+// the whole text; if even that doesn't parse, the edit is undone and the error thrown.
+
+namespace impl {
+
+constexpr std::size_t entry_size(std::uint64_t entry) noexcept
+{
+   switch (tag_of(entry)) {
+   case tape_tag::int64:
+   case tape_tag::double_value:
+   case tape_tag::string: return 2;
+   default: return 1;
+   }
+}
+
+// The position of the first character of every value and key on the tape, from a structural scan of its source.
+// Both entries of a two-entry value get the same position, so positions never decrease.
+constexpr std::vector<std::uint32_t> tape_positions(const std::vector<std::uint64_t>& entries, std::string_view text)
+{
+   const auto indexes = find_structural_indexes(text);
+   std::vector<std::uint32_t> to_ret(entries.size());
+   std::size_t index = 0;
+   for (std::size_t i = 0; i < entries.size(); i += entry_size(entries[i])) {
+      while (text[indexes[index]] == ':' || text[indexes[index]] == ',') {
+         index += 1;
+      }
+      std::fill_n(to_ret.begin() + i, entry_size(entries[i]), indexes[index]);
+      // A string is two structural characters, its quotes
+      index += tag_of(entries[i]) == tape_tag::string ? 2 : 1;
+   }
+   return to_ret;
+}
+
+inline constexpr std::uint32_t no_parent = static_cast<std::uint32_t>(-1);
+
+constexpr bool is_open_entry(std::uint64_t entry) noexcept
+{
+   return tag_of(entry) == tape_tag::object_begin || tag_of(entry) == tape_tag::array_begin;
+}
+
+constexpr bool is_close_entry(std::uint64_t entry) noexcept
+{
+   return tag_of(entry) == tape_tag::object_end || tag_of(entry) == tape_tag::array_end;
+}
+
+// The open entry of the container every entry is directly in, or no_parent at the root. A container's closing
+// entry is in the same container as its opening one.
+constexpr std::vector<std::uint32_t> tape_parents(const std::vector<std::uint64_t>& entries)
+{
+   std::vector<std::uint32_t> to_ret(entries.size());
+   std::vector<std::uint32_t> open;
+   for (std::size_t i = 0; i < entries.size(); i += entry_size(entries[i])) {
+      if (is_close_entry(entries[i])) {
+         open.pop_back();
+      }
+      std::fill_n(to_ret.begin() + i, entry_size(entries[i]), open.empty() ? no_parent : open.back());
+      if (is_open_entry(entries[i])) {
+         open.push_back(static_cast<std::uint32_t>(i));
+      }
+   }
+   return to_ret;
+}
+
+// Replaces count elements of to at index at with all of from. The elements after them are moved once, and not at
+// all if the sizes match.
+template<typename T>
+constexpr void splice(std::vector<T>& to, std::size_t at, std::size_t count, const std::vector<T>& from)
+{
+   const auto common = std::min(count, from.size());
+   const auto first = to.begin() + static_cast<std::ptrdiff_t>(at);
+   const auto rest = from.begin() + static_cast<std::ptrdiff_t>(common);
+   std::copy(from.begin(), rest, first);
+   if (from.size() > count) {
+      to.insert(first + static_cast<std::ptrdiff_t>(common), rest, from.end());
+   }
+   else {
+      to.erase(first + static_cast<std::ptrdiff_t>(common), first + static_cast<std::ptrdiff_t>(count));
+   }
+}
+
+} // namespace impl
+
+class json_editable_document {
+public:
+   constexpr explicit json_editable_document(std::string text, parse_options options = {})
+      : text_{std::move(text)}
+      , options_{options}
+   {
+      parse_all();
+   }
+
+   constexpr tape_value root() const noexcept { return {entries_.data(), entries_.data(), text_}; }
+
+   constexpr std::string_view text() const noexcept { return text_; }
+   constexpr const std::vector<std::uint64_t>& entries() const noexcept { return entries_; }
+   constexpr const std::vector<std::uint32_t>& positions() const noexcept { return positions_; }
+
+   // Replaces count characters of the text at offset. tape_values from before the edit are invalidated.
+   constexpr void replace(std::size_t offset, std::size_t count, const std::string_view replacement)
+   {
+      if (offset > text_.size() || count > text_.size() - offset) {
+         throw std::runtime_error{"edit outside of the JSON text"};
+      }
+      const std::string removed{std::string_view{text_}.substr(offset, count)};
+      text_.replace(offset, count, replacement);
+      const auto shift = static_cast<std::int64_t>(replacement.size()) - static_cast<std::int64_t>(count);
+      try {
+         for (auto open = enclosing(offset, offset + count); open != no_entry;
+              open = enclosing(positions_[open], positions_[close_of(open)] + 1)) {
+            if (reparse(open, shift)) {
+               return;
+            }
+         }
+         parse_all();
+      }
+      catch (...) {
+         text_.replace(offset, replacement.size(), removed);
+         throw;
+      }
+   }
+
+private:
+   static constexpr std::size_t no_entry = static_cast<std::size_t>(-1);
+
+   constexpr void parse_all()
+   {
+      std::vector<std::uint64_t> entries;
+      auto builder = impl::tape_builder{text_, entries};
+      parse_json_events(text_, builder, options_);
+      positions_ = impl::tape_positions(entries, text_);
+      parents_ = impl::tape_parents(entries);
+      entries_ = std::move(entries);
+   }
+
+   constexpr std::size_t close_of(std::size_t open) const noexcept
+   {
+      return (impl::payload_of(entries_[open]) & 0xFFFF'FFFF) - 1;
+   }
+
+   // The first of the entries of the value that entry i is part of
+   constexpr std::size_t first_entry(std::size_t i) const noexcept
+   {
+      return static_cast<std::size_t>(
+         std::lower_bound(positions_.begin(), positions_.begin() + static_cast<std::ptrdiff_t>(i), positions_[i])
+         - positions_.begin());
+   }
+
+   constexpr std::size_t parent_of(std::size_t i) const noexcept
+   {
+      return parents_[i] == impl::no_parent ? no_entry : parents_[i];
+   }
+
+   // Innermost container whose text strictly contains [first, last), leaving its brackets alone
+   constexpr std::size_t enclosing(std::size_t first, std::size_t last) const noexcept
+   {
+      const auto before = std::lower_bound(positions_.begin(), positions_.end(), first) - positions_.begin();
+      if (before == 0) {
+         return no_entry;
+      }
+      // The last entry before first is either a container still open at first, or a value in one
+      auto i = first_entry(static_cast<std::size_t>(before - 1));
+      if (!impl::is_open_entry(entries_[i])) {
+         i = parent_of(i);
+      }
+      for (; i != no_entry; i = parent_of(i)) {
+         if (last <= positions_[close_of(i)]) {
+            return i;
+         }
+      }
+      return no_entry;
+   }
+
+   // Parses the text of the container at entry open, as it is after an edit of shift characters inside it, and
+   // splices it in. Returns false if that text doesn't parse on its own.
+   constexpr bool reparse(std::size_t open, std::int64_t shift)
+   {
+      const auto close = close_of(open);
+      std::vector<std::size_t> ancestors;
+      for (auto i = parent_of(open); i != no_entry; i = parent_of(i)) {
+         ancestors.push_back(i);
+      }
+
+      const auto first = positions_[open];
+      const auto size = static_cast<std::size_t>(static_cast<std::int64_t>(positions_[close] + 1 - first) + shift);
+      const auto text = std::string_view{text_}.substr(first, size);
+      std::vector<std::uint64_t> entries;
+      try {
+         auto builder = impl::tape_builder{text, entries};
+         parse_json_events(text, builder, {.max_depth = options_.max_depth - ancestors.size()});
+      }
+      catch (const std::runtime_error&) {
+         return false;
+      }
+      auto positions = impl::tape_positions(entries, text);
+      auto parents = impl::tape_parents(entries);
+
+      // The new entries are relative to the container's text and first entry
+      for (std::size_t i = 0; i < entries.size(); i += impl::entry_size(entries[i])) {
+         entries[i] = offset_entry(entries[i], first, open, 0);
+      }
+      for (auto& position : positions) {
+         position += first;
+      }
+      for (auto& parent : parents) {
+         parent = parent == impl::no_parent ? parents_[open] : static_cast<std::uint32_t>(parent + open);
+      }
+
+      // Later entries move by the change in the number of entries, and their text by the size of the edit
+      const auto old_end = close + 1;
+      const auto moved = static_cast<std::int64_t>(entries.size()) - static_cast<std::int64_t>(old_end - open);
+      if (shift != 0 || moved != 0) {
+         for (auto i = old_end; i < entries_.size(); i += impl::entry_size(entries_[i])) {
+            entries_[i] = offset_entry(entries_[i], shift, moved, old_end);
+         }
+         for (auto i = old_end; i < positions_.size(); ++i) {
+            positions_[i] = static_cast<std::uint32_t>(positions_[i] + shift);
+            if (parents_[i] != impl::no_parent && parents_[i] >= old_end) {
+               parents_[i] = static_cast<std::uint32_t>(parents_[i] + moved);
+            }
+         }
+         for (const auto ancestor : ancestors) {
+            entries_[ancestor] = offset_entry(entries_[ancestor], 0, moved, old_end);
+         }
+      }
+
+      impl::splice(entries_, open, old_end - open, entries);
+      impl::splice(positions_, open, old_end - open, positions);
+      impl::splice(parents_, open, old_end - open, parents);
+      return true;
+   }
+
+   // Moves a string entry's text by shift and a container entry's index of its other end by moved, if that
+   // index is at or after from
+   static constexpr std::uint64_t offset_entry(
+      std::uint64_t entry, std::int64_t shift, std::int64_t moved, std::size_t from) noexcept
+   {
+      const auto tag = impl::tag_of(entry);
+      const auto payload = impl::payload_of(entry);
+      switch (tag) {
+      case tape_tag::string: return impl::make_entry(tag, static_cast<std::uint64_t>(payload + shift));
+      case tape_tag::object_begin:
+      case tape_tag::array_begin: {
+         const auto index = payload & 0xFFFF'FFFF;
+         if (index < from) {
+            return entry;
+         }
+         const auto moved_index = static_cast<std::uint64_t>(index + moved);
+         return impl::make_entry(tag, (payload & ~std::uint64_t{0xFFFF'FFFF}) | moved_index);
+      }
+      case tape_tag::object_end:
+      case tape_tag::array_end:
+         return payload < from ? entry : impl::make_entry(tag, static_cast<std::uint64_t>(payload + moved));
+      default: return entry;
+      }
+   }
+
+   std::string text_;
+   parse_options options_;
+   std::vector<std::uint64_t> entries_;
+   std::vector<std::uint32_t> positions_;
+   std::vector<std::uint32_t> parents_;
+};
+
+#endif // JSON_EDIT_HPP
@@ -0,0 +1,52 @@
+#include "common.hpp"
+#include "json_format.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <print>
+
+// Files pulled in with #embed rather than pasted into literals. CMake tracks them as dependencies of this file,
+// see json_pack_data in CMakeLists.txt.
+
+// A small schema file goes through the same consteval path as a literal would
+constexpr char struct_info[]{
+#embed "data/struct_info.json" suffix(, '\0')
+};
+
+struct point;
+consteval { make_struct_from_json(^^point, struct_info); }
+constexpr auto points = make_data_from_json<point>(struct_info);
+
+static_assert(points.size() == 2 && points[1].x == 2);
+
+// reference_rows.json is generated with 100 000 rows, far more than make_data_from_json can evaluate. json_pack
+// packs it at build time, and only the format it writes alongside the image is parsed here.
+constexpr char reference_format[]{
+#embed "reference_rows.format.json" suffix(, '\0')
+};
+
+constexpr unsigned char reference_image[]{
+#embed "reference_rows.bin"
+};
+
+struct reference_row;
+consteval { make_struct_from_json(^^reference_row, reference_format); }
+
+static_assert(matches_packed_layout<reference_row>(reference_format));
+
+constexpr auto reference_rows = packed_rows<reference_row>{reference_image};
+
+static_assert(reference_rows.size() == 100'000);
+static_assert(reference_rows[99'999].id == 99'999 && reference_rows[99'999].x == 999 && reference_rows[1].y == -493);
+
+int main()
+{
+   std::int64_t id_sum = 0;
+   std::int64_t flags_sum = 0;
+   for (const auto row : reference_rows) {
+      id_sum += row.id;
+      flags_sum += row.flags;
+   }
+   assert(id_sum == std::int64_t{99'999} * 100'000 / 2);
+   std::println("{} packed rows of {} bytes, flags sum {}", reference_rows.size(), sizeof(reference_row), flags_sum);
+}
@@ -0,0 +1,327 @@
+#ifndef JSON_FILE_HPP
+#define JSON_FILE_HPP
+
+#include "json_push.hpp"
+#include "json_sax.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// File input for the parsers, in two forms. json_file holds a whole file as one contiguous string_view, which
+// every parser can take as it is: a regular file is mapped rather than read, so nothing is copied at all. For
+// pipes and other inputs that can't be mapped, read_pipelined reads into two buffers in turn, so that the
+// previous chunk is being parsed while the next one is read.
+
+namespace impl {
+
+[[noreturn]] inline void throw_errno(const char* what)
+{
+   throw std::system_error{errno, std::generic_category(), what};
+}
+
+// Reads until size bytes have been read or the input ends, and returns how many were read
+inline std::size_t read_fully(int fd, char* out, std::size_t size)
+{
+   std::size_t total = 0;
+   while (total < size) {
+      const auto count = ::read(fd, out + total, size - total);
+      if (count < 0 && errno == EINTR) {
+         continue;
+      }
+      if (count < 0) {
+         throw_errno("read");
+      }
+      if (count == 0) {
+         break;
+      }
+      total += static_cast<std::size_t>(count);
+   }
+   return total;
+}
+
+} // namespace impl
+
+class json_file {
+public:
+   // The text is always followed by at least this many readable zero bytes, so vectorized code can load whole
+   // blocks past its end
+   static constexpr std::size_t padding = 64;
+
+   explicit json_file(const char* path)
+   {
+      const auto fd = ::open(path, O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+         impl::throw_errno(path);
+      }
+      try {
+         struct stat info;
+         if (::fstat(fd, &info) != 0) {
+            impl::throw_errno(path);
+         }
+         if (S_ISREG(info.st_mode) && info.st_size > 0) {
+            map(fd, static_cast<std::size_t>(info.st_size));
+         }
+         else {
+            read_all(fd);
+         }
+      }
+      catch (...) {
+         ::close(fd);
+         throw;
+      }
+      ::close(fd);
+   }
+
+   json_file(json_file&& other) noexcept
+      : text_{std::exchange(other.text_, {})}
+      , mapping_{std::exchange(other.mapping_, nullptr)}
+      , mapping_size_{std::exchange(other.mapping_size_, 0)}
+      , buffer_{std::move(other.buffer_)}
+   {
+   }
+
+   json_file& operator=(json_file&& other) noexcept
+   {
+      std::swap(text_, other.text_);
+      std::swap(mapping_, other.mapping_);
+      std::swap(mapping_size_, other.mapping_size_);
+      std::swap(buffer_, other.buffer_);
+      return *this;
+   }
+
+   ~json_file()
+   {
+      if (mapping_ != nullptr) {
+         ::munmap(mapping_, mapping_size_);
+      }
+   }
+
+   std::string_view view() const noexcept { return text_; }
+   bool is_mapped() const noexcept { return mapping_ != nullptr; }
+
+private:
+   // Anonymous memory is reserved first and the file mapped over the front of it, so the padding is zeroed
+   // memory even when the file ends exactly on a page boundary
+   void map(int fd, std::size_t size)
+   {
+      const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+      mapping_size_ = (size + padding + page_size - 1) / page_size * page_size;
+      const auto reserved = ::mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (reserved == MAP_FAILED) {
+         impl::throw_errno("mmap");
+      }
+      if (::mmap(reserved, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+         const auto error = errno;
+         ::munmap(reserved, mapping_size_);
+         errno = error;
+         impl::throw_errno("mmap");
+      }
+      mapping_ = reserved;
+      // Parsers go through the text once from front to back, so aggressive read-ahead pays off
+      ::madvise(reserved, size, MADV_SEQUENTIAL);
+      text_ = {static_cast<const char*>(reserved), size};
+   }
+
+   void read_all(int fd)
+   {
+      std::size_t capacity = 1 << 16;
+      std::size_t size = 0;
+      while (true) {
+         auto grown = std::make_unique_for_overwrite<char[]>(capacity + padding);
+         std::copy_n(buffer_.get(), size, grown.get());
+         buffer_ = std::move(grown);
+         const auto count = impl::read_fully(fd, buffer_.get() + size, capacity - size);
+         size += count;
+         if (size < capacity) {
+            break;
+         }
+         capacity *= 2;
+      }
+      std::fill_n(buffer_.get() + size, padding, '\0');
+      text_ = {buffer_.get(), size};
+   }
+
+   std::string_view text_;
+   void* mapping_ = nullptr;
+   std::size_t mapping_size_ = 0;
+   std::unique_ptr<char[]> buffer_;
+};
+
+namespace impl {
+
+// Reads fd on a thread of its own, into two buffers in turn. Each chunk is handed over after a single read(), so
+// data is passed on as soon as it arrives rather than once a buffer is full. Destroying the reader stops the
+// thread even if it's waiting on an input that never ends, e.g., a pipe whose writer is still open.
+class pipelined_reader {
+public:
+   pipelined_reader(int fd, std::size_t chunk_size)
+      : fd_{fd}
+      , chunk_size_{chunk_size}
+      , buffers_{
+           std::make_unique_for_overwrite<char[]>(chunk_size), std::make_unique_for_overwrite<char[]>(chunk_size)}
+   {
+      // poll ignores an fd that isn't open rather than failing, so that's checked here instead
+      if (::fcntl(fd, F_GETFD) < 0) {
+         throw_errno("read");
+      }
+      if (::pipe(cancel_fds_) != 0) {
+         throw_errno("pipe");
+      }
+      reader_ = std::jthread{[this] { run(); }};
+   }
+
+   pipelined_reader(const pipelined_reader&) = delete;
+   pipelined_reader& operator=(const pipelined_reader&) = delete;
+
+   ~pipelined_reader()
+   {
+      {
+         std::scoped_lock lock{mutex_};
+         stopping_ = true;
+      }
+      changed_.notify_all();
+      // Wakes the reader up if it's waiting for fd; if this can't be written, the pipe already holds a byte
+      const char wake = 0;
+      [[maybe_unused]] const auto written = ::write(cancel_fds_[1], &wake, 1);
+      reader_.join();
+      ::close(cancel_fds_[0]);
+      ::close(cancel_fds_[1]);
+   }
+
+   // The next chunk, or an empty view once the input has ended. Only valid until next is called again, when its
+   // buffer is handed back to be read into. Errors reading fd are thrown here, after the chunks before them.
+   std::string_view next()
+   {
+      std::unique_lock lock{mutex_};
+      if (holding_) {
+         holding_ = false;
+         in_use_ -= 1;
+         changed_.notify_all();
+      }
+      changed_.wait(lock, [&] { return filled_ != 0; });
+      filled_ -= 1;
+      const auto index = std::exchange(take_index_, take_index_ ^ 1);
+      if (sizes_[index] == 0) {
+         if (error_) {
+            std::rethrow_exception(error_);
+         }
+         return {};
+      }
+      holding_ = true;
+      return {buffers_[index].get(), sizes_[index]};
+   }
+
+private:
+   void run()
+   {
+      for (std::size_t index = 0;; index ^= 1) {
+         {
+            std::unique_lock lock{mutex_};
+            changed_.wait(lock, [&] { return stopping_ || in_use_ < 2; });
+            if (stopping_) {
+               return;
+            }
+         }
+         std::size_t size = 0;
+         std::exception_ptr error;
+         try {
+            size = read_some(buffers_[index].get());
+         }
+         catch (...) {
+            error = std::current_exception();
+         }
+         {
+            std::scoped_lock lock{mutex_};
+            sizes_[index] = size;
+            error_ = error;
+            in_use_ += 1;
+            filled_ += 1;
+         }
+         changed_.notify_all();
+         if (size == 0) {
+            return;
+         }
+      }
+   }
+
+   // Waits for fd or for cancellation, then reads whatever there is; 0 at the end of input or when cancelled
+   std::size_t read_some(char* out)
+   {
+      ::pollfd fds[]{{fd_, POLLIN, 0}, {cancel_fds_[0], POLLIN, 0}};
+      while (true) {
+         if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+               continue;
+            }
+            throw_errno("poll");
+         }
+         if (fds[1].revents != 0) {
+            return 0;
+         }
+         const auto count = ::read(fd_, out, chunk_size_);
+         if (count < 0 && (errno == EINTR || errno == EAGAIN)) {
+            continue;
+         }
+         if (count < 0) {
+            throw_errno("read");
+         }
+         return static_cast<std::size_t>(count);
+      }
+   }
+
+   int fd_;
+   std::size_t chunk_size_;
+   std::unique_ptr<char[]> buffers_[2];
+   int cancel_fds_[2];
+   std::mutex mutex_;
+   std::condition_variable changed_;
+   // Buffers that are filled or held by the consumer, of which filled_ are waiting to be taken
+   std::size_t in_use_ = 0;
+   std::size_t filled_ = 0;
+   std::size_t sizes_[2]{};
+   std::size_t take_index_ = 0;
+   bool holding_ = false;
+   bool stopping_ = false;
+   std::exception_ptr error_;
+   std::jthread reader_;
+};
+
+} // namespace impl
+
+// Calls consume(chunk) for consecutive chunks of fd until it ends. While one chunk is being consumed the next is
+// read on another thread, into the other of two buffers, so a chunk is only valid until consume returns. A chunk
+// is whatever a single read() gave, up to chunk_size bytes, so slow input is consumed as it comes in. If consume
+// throws, the read in progress is abandoned.
+void read_pipelined(int fd, const auto& consume, std::size_t chunk_size = 1 << 20)
+{
+   impl::pipelined_reader reader{fd, chunk_size};
+   for (auto chunk = reader.next(); !chunk.empty(); chunk = reader.next()) {
+      consume(chunk);
+   }
+}
+
+// parse_json_events for input that can't be held all at once, e.g., a pipe. As with json_push_parser, strings
+// and keys are only valid for the duration of the handler call.
+void parse_json_stream(
+   int fd, json_handler auto& handler, push_options options = {}, std::size_t chunk_size = 1 << 20)
+{
+   json_push_parser parser{handler, options};
+   read_pipelined(fd, [&](std::string_view chunk) { parser.feed(chunk); }, chunk_size);
+   parser.finish();
+}
+
+#endif // JSON_FILE_HPP
@@ -0,0 +1,198 @@
+#ifndef JSON_FORMAT_HPP
+#define JSON_FORMAT_HPP
+
+#include "common.hpp"
+#include "json_parse.hpp"
+#include "json_reflect.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <experimental/meta>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Structs described by a "format" object of member names and integer types, with their rows in "data":
+//
+//    {"format": {"x": "i32", "y": "i32"}, "data": [{"x": 1, "y": 1}, {"x": 2, "y": 2}]}
+//
+// make_data_from_json reads small "data" arrays in constant evaluation. Large ones are packed into an image of
+// the rows ahead of time by json_pack and read in place with packed_rows, so the compiler never evaluates them.
+
+constexpr auto format_type_mapping = std::to_array<std::pair<std::string_view, std::meta::info>>({
+   {"i8", ^^tdef<std::int8_t>::type},
+   {"i16", ^^tdef<std::int16_t>::type},
+   {"i32", ^^tdef<std::int32_t>::type},
+   {"i64", ^^tdef<std::int64_t>::type},
+   {"u8", ^^tdef<std::uint8_t>::type},
+   {"u16", ^^tdef<std::uint16_t>::type},
+   {"u32", ^^tdef<std::uint32_t>::type},
+   {"u64", ^^tdef<std::uint64_t>::type},
+});
+
+consteval std::meta::info make_struct_from_json(std::meta::info to_complete, const std::string_view json_str)
+{
+   const auto json = parse_json(json_str);
+   const auto& format_info = get_by_key(std::get<json_map>(json), "format");
+   std::vector<std::meta::info> members;
+   for (const auto& [name, type_raw] : std::get<json_map>(format_info)) {
+      const auto& type = std::get<std::string_view>(type_raw);
+      members.push_back(std::meta::data_member_spec(get_by_key(format_type_mapping, type), {.name = name}));
+   }
+   return std::meta::define_aggregate(to_complete, members);
+}
+
+template<typename T>
+consteval auto make_data_from_json(const std::string_view json_str)
+{
+   // "format" isn't a member, so it's skipped rather than parsed
+   struct data_holder {
+      std::vector<T> data;
+   };
+   return ::define_static_array(from_json<data_holder>(json_str).data);
+}
+
+struct packed_type {
+   std::string_view name;
+   std::size_t size;
+   bool is_signed;
+};
+
+namespace impl {
+
+inline constexpr auto packed_types = std::to_array<packed_type>({
+   {"i8", 1, true},
+   {"i16", 2, true},
+   {"i32", 4, true},
+   {"i64", 8, true},
+   {"u8", 1, false},
+   {"u16", 2, false},
+   {"u32", 4, false},
+   {"u64", 8, false},
+});
+
+} // namespace impl
+
+struct packed_member {
+   std::string_view name;
+   packed_type type;
+   std::size_t offset;
+};
+
+struct packed_layout {
+   std::vector<packed_member> members;
+   std::size_t size = 0;
+};
+
+// Where the members of the struct make_struct_from_json defines for format are: in order, each at the next
+// multiple of its own size, with the whole padded to its largest member
+constexpr packed_layout layout_of_format(const json_map& format)
+{
+   packed_layout to_ret;
+   std::size_t alignment = 1;
+   for (const auto& [name, type_raw] : format) {
+      const auto type = std::ranges::find(impl::packed_types, std::get<std::string_view>(type_raw), &packed_type::name);
+      if (type == impl::packed_types.end()) {
+         throw std::runtime_error{"unknown format type"};
+      }
+      to_ret.size = (to_ret.size + type->size - 1) / type->size * type->size;
+      to_ret.members.push_back({name, *type, to_ret.size});
+      to_ret.size += type->size;
+      alignment = std::max(alignment, type->size);
+   }
+   to_ret.size = (to_ret.size + alignment - 1) / alignment * alignment;
+   return to_ret;
+}
+
+// Whether T has the layout json_pack packed json_str's rows with, for a static_assert next to the image
+template<typename T>
+consteval bool matches_packed_layout(const std::string_view json_str)
+{
+   const auto json = parse_json(json_str);
+   const auto layout = layout_of_format(std::get<json_map>(get_by_key(std::get<json_map>(json), "format")));
+   const auto members = std::meta::nonstatic_data_members_of(^^T, std::meta::access_context::unchecked());
+   if (sizeof(T) != layout.size || members.size() != layout.members.size()) {
+      return false;
+   }
+   for (std::size_t i = 0; i < members.size(); ++i) {
+      if (std::meta::identifier_of(members[i]) != layout.members[i].name
+          || std::meta::offset_of(members[i]).bytes != layout.members[i].offset
+          || std::meta::size_of(members[i]) != layout.members[i].type.size) {
+         return false;
+      }
+   }
+   return true;
+}
+
+// Rows of T in an image made by json_pack, e.g., one pulled in with #embed. A row is bit_cast out of the bytes
+// when it's read, so a constant image costs the compiler nothing until its rows are used.
+template<typename T>
+   requires std::is_trivially_copyable_v<T>
+class packed_rows {
+public:
+   class iterator {
+   public:
+      using value_type = T;
+      using difference_type = std::ptrdiff_t;
+
+      constexpr iterator() noexcept = default;
+
+      constexpr iterator(const packed_rows* rows, std::size_t index) noexcept : rows_{rows}, index_{index} {}
+
+      constexpr T operator*() const { return (*rows_)[index_]; }
+
+      constexpr iterator& operator++() noexcept
+      {
+         ++index_;
+         return *this;
+      }
+
+      constexpr iterator operator++(int) noexcept
+      {
+         auto to_ret = *this;
+         ++*this;
+         return to_ret;
+      }
+
+      friend constexpr bool operator==(const iterator& lhs, const iterator& rhs) noexcept
+      {
+         return lhs.index_ == rhs.index_;
+      }
+
+   private:
+      const packed_rows* rows_ = nullptr;
+      std::size_t index_ = 0;
+   };
+
+   constexpr explicit packed_rows(std::span<const unsigned char> image) : image_{image}
+   {
+      if (image.size() % sizeof(T) != 0) {
+         throw std::runtime_error{"packed image isn't a whole number of rows"};
+      }
+   }
+
+   constexpr std::size_t size() const noexcept { return image_.size() / sizeof(T); }
+   constexpr bool empty() const noexcept { return image_.empty(); }
+
+   constexpr T operator[](std::size_t index) const
+   {
+      if (index >= size()) {
+         throw std::runtime_error{"row index out of range"};
+      }
+      std::array<unsigned char, sizeof(T)> bytes;
+      std::ranges::copy(image_.subspan(index * sizeof(T), sizeof(T)), bytes.begin());
+      return std::bit_cast<T>(bytes);
+   }
+
+   constexpr iterator begin() const noexcept { return {this, 0}; }
+   constexpr iterator end() const noexcept { return {this, size()}; }
+
+private:
+   std::span<const unsigned char> image_;
+};
+
+#endif // JSON_FORMAT_HPP
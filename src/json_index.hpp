@@ -0,0 +1,88 @@
+#ifndef JSON_INDEX_HPP
+#define JSON_INDEX_HPP
+
+#include "json_parse.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+// Key index over a json_map, built once and reused for every lookup after that. Small objects are faster to
+// scan than to hash (see json_index_bench.cpp for where the two cross over), so below hash_threshold members
+// no table is built and lookups stay linear. As with get_by_key, the first of any duplicate keys is found.
+// The map must outlive the index and not be modified while it's in use.
+class json_map_index {
+public:
+   static constexpr std::size_t hash_threshold = 16;
+
+   constexpr explicit json_map_index(const json_map& map, std::size_t threshold = hash_threshold) : map_{&map}
+   {
+      if (map.size() < threshold) {
+         return;
+      }
+      if (map.size() >= no_member) {
+         throw std::runtime_error{"JSON object too large to index"};
+      }
+      table_.resize(std::bit_ceil(map.size() * 2), slot{0, no_member});
+      const auto mask = table_.size() - 1;
+      for (std::uint32_t i = 0; i < map.size(); ++i) {
+         const auto hash = impl::hash_name(map[i].first);
+         auto index = hash & mask;
+         while (table_[index].member != no_member) {
+            index = (index + 1) & mask;
+         }
+         table_[index] = {static_cast<std::uint32_t>(hash >> 32), i};
+      }
+   }
+
+   constexpr const json_value* find(const std::string_view key) const noexcept
+   {
+      if (table_.empty()) {
+         return get_by_key_opt(*map_, key);
+      }
+      const auto hash = impl::hash_name(key);
+      const auto mask = table_.size() - 1;
+      // Linear probing keeps earlier members ahead of later ones with the same key
+      for (auto index = hash & mask; table_[index].member != no_member; index = (index + 1) & mask) {
+         const auto& [tag, member] = table_[index];
+         if (tag == static_cast<std::uint32_t>(hash >> 32) && (*map_)[member].first == key) {
+            return &(*map_)[member].second;
+         }
+      }
+      return nullptr;
+   }
+
+   constexpr bool is_hashed() const noexcept { return !table_.empty(); }
+
+   constexpr const json_map& map() const noexcept { return *map_; }
+
+private:
+   static constexpr auto no_member = std::numeric_limits<std::uint32_t>::max();
+
+   // The upper half of the hash is kept so most mismatches are rejected without a string compare
+   struct slot {
+      std::uint32_t tag;
+      std::uint32_t member;
+   };
+
+   const json_map* map_;
+   std::vector<slot> table_;
+};
+
+constexpr const json_value* get_by_key_opt(const json_map_index& index, const std::string_view key) noexcept
+{
+   return index.find(key);
+}
+
+constexpr const json_value& get_by_key(const json_map_index& index, const std::string_view key)
+{
+   if (const auto val = index.find(key)) {
+      return *val;
+   }
+   throw std::runtime_error{"no matching key found"};
+}
+
+#endif // JSON_INDEX_HPP
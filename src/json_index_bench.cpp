@@ -0,0 +1,54 @@
+#include "json_index.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <print>
+#include <random>
+#include <string>
+#include <vector>
+
+// Average time per lookup for a linear scan versus a hashed json_map_index, across object sizes; hash_threshold
+// in json_index.hpp should sit about where the hashed column starts winning
+double ns_per_lookup(const auto& lookup, const std::vector<std::string_view>& keys, std::size_t num_lookups)
+{
+   std::int64_t sum = 0;
+   const auto start = std::chrono::steady_clock::now();
+   for (std::size_t i = 0; i < num_lookups; ++i) {
+      sum += std::get<std::int64_t>(get_by_key(lookup, keys[i % keys.size()]));
+   }
+   const auto stop = std::chrono::steady_clock::now();
+   // Keep the lookups from being optimized out
+   assert(sum >= 0);
+   volatile auto sink = sum;
+   (void)sink;
+   return std::chrono::duration<double, std::nano>(stop - start).count() / static_cast<double>(num_lookups);
+}
+
+int main()
+{
+   constexpr std::size_t num_lookups = 2'000'000;
+   std::mt19937 rng{42};
+   std::println("{:>8} {:>12} {:>12}", "members", "linear ns", "hashed ns");
+   for (const std::size_t size : {1, 2, 4, 8, 12, 16, 24, 32, 64, 128, 256, 1024, 4096}) {
+      std::vector<std::string> names;
+      for (std::size_t i = 0; i < size; ++i) {
+         names.push_back(std::format("feature_flag_{}", i));
+      }
+      json_map map;
+      for (std::size_t i = 0; i < size; ++i) {
+         map.emplace_back(names[i], static_cast<std::int64_t>(i));
+      }
+      std::vector<std::string_view> keys{names.begin(), names.end()};
+      std::ranges::shuffle(keys, rng);
+
+      const auto hashed = json_map_index{map, 0};
+      assert(hashed.is_hashed());
+      std::println(
+         "{:>8} {:>12.2f} {:>12.2f}",
+         size,
+         ns_per_lookup(map, keys, num_lookups),
+         ns_per_lookup(hashed, keys, num_lookups));
+   }
+}
@@ -0,0 +1,422 @@
+#ifndef JSON_LAZY_HPP
+#define JSON_LAZY_HPP
+
+#include "json_number.hpp"
+#include "json_simd.hpp"
+
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// A document that's only parsed where it's read. Construction runs the structural scan (see json_simd.hpp), and
+// after that values are found by walking the structural positions: looking up a key or an index steps over the
+// members before it by matching brackets, without building or even looking at anything inside them. Reading a
+// few fields out of a large document costs the scan plus the walk, instead of a json_value per member.
+//
+// Malformed JSON is only reported in the parts that are visited. As with parse_json, strings still contain
+// their escape sequences and refer to the source text, which must outlive the document.
+
+class lazy_map;
+class lazy_array;
+
+class lazy_value {
+public:
+   constexpr lazy_value(std::string_view json, const std::uint32_t* indexes, std::size_t count, std::size_t at) noexcept
+      : json_{json}
+      , indexes_{indexes}
+      , count_{count}
+      , at_{at}
+   {
+   }
+
+   template<typename T>
+   constexpr bool holds() const
+   {
+      const auto c = first_char();
+      if constexpr (std::same_as<T, std::int64_t> || std::same_as<T, double>) {
+         if (c != '-' && (c < '0' || c > '9')) {
+            return false;
+         }
+         const auto number = number_value();
+         return number && std::holds_alternative<T>(number->value);
+      }
+      else if constexpr (std::same_as<T, bool>) {
+         return scalar_text() == "true" || scalar_text() == "false";
+      }
+      else if constexpr (std::same_as<T, std::nullptr_t>) {
+         return scalar_text() == "null";
+      }
+      else if constexpr (std::same_as<T, std::string_view>) {
+         return c == '"';
+      }
+      else if constexpr (std::same_as<T, lazy_map>) {
+         return c == '{';
+      }
+      else if constexpr (std::same_as<T, lazy_array>) {
+         return c == '[';
+      }
+      else {
+         static_assert(false, "not a JSON value type");
+      }
+   }
+
+   // Structural position after this value and all of its children. Brackets inside strings aren't structural,
+   // so containers are skipped by counting brackets alone.
+   constexpr std::size_t next_index() const
+   {
+      switch (first_char()) {
+      case '{':
+      case '[': {
+         std::size_t depth = 0;
+         auto index = at_;
+         do {
+            const auto c = char_at(index++);
+            if (c == '{' || c == '[') {
+               depth += 1;
+            }
+            else if (c == '}' || c == ']') {
+               depth -= 1;
+            }
+         } while (depth != 0);
+         return index;
+      }
+      case '"': return at_ + 2;
+      default: return at_ + 1;
+      }
+   }
+
+   // The value's text in the source, e.g., for parse_json to build a json_value out of just this part
+   constexpr std::string_view source() const
+   {
+      if (first_char() == '{' || first_char() == '[') {
+         const auto first = indexes_[at_];
+         return json_.substr(first, indexes_[next_index() - 1] + 1 - first);
+      }
+      if (first_char() == '"') {
+         return json_.substr(indexes_[at_], indexes_[at_ + 1] + 1 - indexes_[at_]);
+      }
+      return scalar_text();
+   }
+
+private:
+   template<typename T>
+   friend constexpr T get(const lazy_value& v);
+
+   friend class lazy_map;
+   friend class lazy_array;
+
+   constexpr char char_at(std::size_t index) const
+   {
+      if (index >= count_) {
+         throw std::runtime_error{"unexpected end of JSON input"};
+      }
+      return json_[indexes_[index]];
+   }
+
+   constexpr char first_char() const { return char_at(at_); }
+
+   // Scalars end at the next structural character, or at the end of the input
+   constexpr std::string_view scalar_text() const
+   {
+      const auto first = indexes_[at_];
+      const auto last = at_ + 1 < count_ ? indexes_[at_ + 1] : json_.size();
+      auto to_ret = json_.substr(first, last - first);
+      while (!to_ret.empty() && impl::is_whitespace(to_ret.back())) {
+         to_ret.remove_suffix(1);
+      }
+      return to_ret;
+   }
+
+   // Between the quotes, escape sequences included
+   constexpr std::string_view string_text() const noexcept
+   {
+      const auto open = indexes_[at_];
+      return json_.substr(open + 1, indexes_[at_ + 1] - open - 1);
+   }
+
+   constexpr std::optional<json_number_result> number_value() const
+   {
+      const auto text = scalar_text();
+      const auto number = try_parse_json_number(text.data(), text.data() + text.size());
+      if (!number || number->ptr != text.data() + text.size()) {
+         return std::nullopt;
+      }
+      return number;
+   }
+
+   constexpr lazy_value at(std::size_t index) const noexcept { return {json_, indexes_, count_, index}; }
+
+   std::string_view json_;
+   const std::uint32_t* indexes_;
+   std::size_t count_;
+   std::size_t at_;
+};
+
+// Forward range over the (key, value) pairs of an object, in document order. Members are located as the range
+// is walked, so the end is a sentinel rather than a position that would take skipping the whole object to find.
+class lazy_map {
+public:
+   class iterator {
+   public:
+      using value_type = std::pair<std::string_view, lazy_value>;
+      using difference_type = std::ptrdiff_t;
+
+      constexpr iterator() noexcept = default;
+
+      constexpr explicit iterator(const lazy_value& pos) noexcept : pos_{pos} {}
+
+      constexpr value_type operator*() const
+      {
+         if (pos_.first_char() != '"') {
+            throw std::runtime_error{"expected string for JSON key"};
+         }
+         if (pos_.char_at(pos_.at_ + 2) != ':') {
+            throw std::runtime_error{"expected colon after JSON key"};
+         }
+         return {pos_.string_text(), pos_.at(pos_.at_ + 3)};
+      }
+
+      constexpr iterator& operator++()
+      {
+         const auto after = pos_.at(pos_.at_ + 3).next_index();
+         const auto sep = pos_.char_at(after);
+         if (sep == ',') {
+            if (pos_.char_at(after + 1) != '"') {
+               throw std::runtime_error{"expected string for JSON key"};
+            }
+            pos_ = pos_.at(after + 1);
+         }
+         else if (sep == '}') {
+            pos_ = pos_.at(after);
+         }
+         else {
+            throw std::runtime_error{"unexpected token after dict value"};
+         }
+         return *this;
+      }
+
+      constexpr iterator operator++(int)
+      {
+         auto to_ret = *this;
+         ++*this;
+         return to_ret;
+      }
+
+      friend constexpr bool operator==(const iterator& lhs, const iterator& rhs) noexcept
+      {
+         return lhs.index() == rhs.index();
+      }
+
+      friend constexpr bool operator==(const iterator& lhs, std::default_sentinel_t) { return lhs.at_end(); }
+
+   private:
+      constexpr std::size_t index() const noexcept { return pos_.at_; }
+      constexpr bool at_end() const { return pos_.first_char() == '}'; }
+
+      lazy_value pos_{{}, nullptr, 0, 0};
+   };
+
+   constexpr explicit lazy_map(const lazy_value& v) noexcept : value_{v} {}
+
+   constexpr iterator begin() const { return iterator{value_.at(value_.at_ + 1)}; }
+   constexpr std::default_sentinel_t end() const noexcept { return {}; }
+
+   // Linear, as every member has to be stepped over
+   constexpr std::size_t size() const
+   {
+      std::size_t to_ret = 0;
+      for (auto iter = begin(); iter != end(); ++iter) {
+         to_ret += 1;
+      }
+      return to_ret;
+   }
+
+   constexpr bool empty() const { return begin() == end(); }
+
+   constexpr lazy_value operator[](std::string_view key) const;
+
+private:
+   lazy_value value_;
+};
+
+// Forward range over the values of an array
+class lazy_array {
+public:
+   class iterator {
+   public:
+      using value_type = lazy_value;
+      using difference_type = std::ptrdiff_t;
+
+      constexpr iterator() noexcept = default;
+
+      constexpr explicit iterator(const lazy_value& pos) noexcept : pos_{pos} {}
+
+      constexpr value_type operator*() const noexcept { return pos_; }
+
+      constexpr iterator& operator++()
+      {
+         const auto after = pos_.next_index();
+         const auto sep = pos_.char_at(after);
+         if (sep == ',') {
+            if (pos_.char_at(after + 1) == ']') {
+               throw std::runtime_error{"unexpected token after array value"};
+            }
+            pos_ = pos_.at(after + 1);
+         }
+         else if (sep == ']') {
+            pos_ = pos_.at(after);
+         }
+         else {
+            throw std::runtime_error{"unexpected token after array value"};
+         }
+         return *this;
+      }
+
+      constexpr iterator operator++(int)
+      {
+         auto to_ret = *this;
+         ++*this;
+         return to_ret;
+      }
+
+      friend constexpr bool operator==(const iterator& lhs, const iterator& rhs) noexcept
+      {
+         return lhs.index() == rhs.index();
+      }
+
+      friend constexpr bool operator==(const iterator& lhs, std::default_sentinel_t) { return lhs.at_end(); }
+
+   private:
+      constexpr std::size_t index() const noexcept { return pos_.at_; }
+      constexpr bool at_end() const { return pos_.first_char() == ']'; }
+
+      lazy_value pos_{{}, nullptr, 0, 0};
+   };
+
+   constexpr explicit lazy_array(const lazy_value& v) noexcept : value_{v} {}
+
+   constexpr iterator begin() const { return iterator{value_.at(value_.at_ + 1)}; }
+   constexpr std::default_sentinel_t end() const noexcept { return {}; }
+
+   constexpr std::size_t size() const
+   {
+      std::size_t to_ret = 0;
+      for (auto iter = begin(); iter != end(); ++iter) {
+         to_ret += 1;
+      }
+      return to_ret;
+   }
+
+   constexpr bool empty() const { return begin() == end(); }
+
+   // Linear, but the elements before index are skipped rather than parsed
+   constexpr lazy_value operator[](std::size_t index) const
+   {
+      auto iter = begin();
+      for (; index != 0 && iter != end(); --index) {
+         ++iter;
+      }
+      if (iter == end()) {
+         throw std::runtime_error{"array index out of range"};
+      }
+      return *iter;
+   }
+
+private:
+   lazy_value value_;
+};
+
+// Mirrors std::get on json_value, e.g., get<lazy_map>(value). Numbers are parsed as they're read.
+template<typename T>
+constexpr T get(const lazy_value& v)
+{
+   if (!v.holds<T>()) {
+      throw std::runtime_error{"JSON value holds a different type"};
+   }
+   if constexpr (std::same_as<T, std::int64_t> || std::same_as<T, double>) {
+      return std::get<T>(v.number_value()->value);
+   }
+   else if constexpr (std::same_as<T, bool>) {
+      return v.scalar_text() == "true";
+   }
+   else if constexpr (std::same_as<T, std::nullptr_t>) {
+      return nullptr;
+   }
+   else if constexpr (std::same_as<T, std::string_view>) {
+      return v.string_text();
+   }
+   else {
+      return T{v};
+   }
+}
+
+// Taken by value so these are preferred over the json_map overloads in json_parse.hpp
+constexpr std::optional<lazy_value> get_by_key_opt(const lazy_map vals, const std::string_view key)
+{
+   for (const auto& [comp_key, value] : vals) {
+      if (comp_key == key) {
+         return value;
+      }
+   }
+   return std::nullopt;
+}
+
+constexpr lazy_value get_by_key(const lazy_map vals, const std::string_view key)
+{
+   if (const auto val = get_by_key_opt(vals, key)) {
+      return *val;
+   }
+   throw std::runtime_error{"no matching key found"};
+}
+
+constexpr lazy_value lazy_map::operator[](std::string_view key) const { return get_by_key(*this, key); }
+
+// Owns the structural positions; the source text is only referenced
+class json_lazy_document {
+public:
+   constexpr json_lazy_document() = default;
+
+   constexpr json_lazy_document(std::vector<std::uint32_t> indexes, std::string_view source) noexcept
+      : indexes_{std::move(indexes)}
+      , source_{source}
+   {
+   }
+
+   constexpr lazy_value root() const noexcept { return {source_, indexes_.data(), indexes_.size(), 0}; }
+
+   constexpr const std::vector<std::uint32_t>& indexes() const noexcept { return indexes_; }
+   constexpr std::string_view source() const noexcept { return source_; }
+
+private:
+   std::vector<std::uint32_t> indexes_;
+   std::string_view source_;
+};
+
+// Only the structural scan happens up front. Checking the root for trailing data would mean skipping all of
+// it, so only its first and last structural characters are compared.
+constexpr json_lazy_document parse_json_lazy(const std::string_view v)
+{
+   auto indexes = find_structural_indexes(v);
+   if (indexes.empty()) {
+      throw std::runtime_error{"unexpected end of JSON input"};
+   }
+   const auto last = v[indexes.back()];
+   bool complete;
+   switch (v[indexes.front()]) {
+   case '{': complete = last == '}'; break;
+   case '[': complete = last == ']'; break;
+   case '"': complete = indexes.size() == 2; break;
+   default: complete = indexes.size() == 1; break;
+   }
+   if (!complete) {
+      throw std::runtime_error{"unexpected data after end of JSON object"};
+   }
+   return json_lazy_document{std::move(indexes), v};
+}
+
+#endif // JSON_LAZY_HPP
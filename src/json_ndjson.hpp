@@ -0,0 +1,109 @@
+#ifndef JSON_NDJSON_HPP
+#define JSON_NDJSON_HPP
+
+#include "json_file.hpp"
+#include "json_parallel.hpp"
+#include "json_reflect.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// JSON Lines input, one document per line. A raw newline can't appear inside a JSON value, so every newline ends
+// a record and the input can be cut into chunks at any newline without looking at what's around it. Chunks are
+// handed out to worker threads in order and each worker parses its records straight into that chunk's vector;
+// the vectors are joined in input order at the end.
+
+namespace impl {
+
+constexpr std::vector<std::string_view> split_ndjson_chunks(const std::string_view input, std::size_t chunk_size)
+{
+   std::vector<std::string_view> to_ret;
+   std::size_t start = 0;
+   while (start < input.size()) {
+      const auto newline = input.find('\n', start + std::max<std::size_t>(chunk_size, 1) - 1);
+      const auto end = newline == std::string_view::npos ? input.size() : newline + 1;
+      to_ret.push_back(input.substr(start, end - start));
+      start = end;
+   }
+   return to_ret;
+}
+
+// Blank lines, including a trailing newline at the end of the input, aren't records
+template<typename T>
+constexpr void read_ndjson_chunk(std::string_view chunk, std::vector<T>& out, auto& read_record)
+{
+   // Counting newlines is vectorized and much cheaper than growing the vector as records are read
+   out.reserve(static_cast<std::size_t>(std::ranges::count(chunk, '\n')) + 1);
+   while (!chunk.empty()) {
+      const auto newline = chunk.find('\n');
+      const auto line = chunk.substr(0, newline);
+      chunk.remove_prefix(newline == std::string_view::npos ? chunk.size() : newline + 1);
+      if (line.find_first_not_of(" \t\r") != std::string_view::npos) {
+         read_record(line, out.emplace_back());
+      }
+   }
+}
+
+// read_record(line, out) parses one line into out; it's shared between threads, so it must not modify any
+// state of its own
+template<typename T>
+std::vector<T> read_ndjson_parallel(const std::string_view input, parallel_options options, const auto& read_record)
+{
+   const auto chunks = split_ndjson_chunks(input, options.chunk_size);
+   std::vector<std::vector<T>> results(chunks.size());
+   run_tasks(
+      chunks.size(), options.threads, [&](std::size_t i) { read_ndjson_chunk(chunks[i], results[i], read_record); });
+   std::size_t total = 0;
+   for (const auto& result : results) {
+      total += result.size();
+   }
+   std::vector<T> to_ret;
+   to_ret.reserve(total);
+   for (auto& result : results) {
+      std::ranges::move(result, std::back_inserter(to_ret));
+   }
+   return to_ret;
+}
+
+} // namespace impl
+
+// Every non-blank line of input read as a T, in order, as from_json would read each one. The result, and the
+// error thrown for bad input, are the same whatever options are used.
+template<typename T>
+std::vector<T> read_ndjson(const std::string_view input, parallel_options options = {})
+{
+   return impl::read_ndjson_parallel<T>(
+      input, options, [](const std::string_view line, T& out) { impl::read_json_document(line, out); });
+}
+
+// read_ndjson for input that can't be held all at once, e.g., a pipe. Each chunk's complete lines are read in
+// parallel while the next chunk is read from fd; only the line split between two chunks is copied.
+template<typename T>
+std::vector<T> read_ndjson_stream(int fd, parallel_options options = {}, std::size_t chunk_size = 16 << 20)
+{
+   std::vector<T> to_ret;
+   std::string split_line;
+   const auto append = [&](std::vector<T> records) { std::ranges::move(records, std::back_inserter(to_ret)); };
+   read_pipelined(
+      fd,
+      [&](std::string_view chunk) {
+         const auto first_newline = chunk.find('\n');
+         if (first_newline == std::string_view::npos) {
+            split_line.append(chunk);
+            return;
+         }
+         split_line.append(chunk.substr(0, first_newline));
+         append(read_ndjson<T>(split_line, options));
+         const auto last_newline = chunk.rfind('\n');
+         append(read_ndjson<T>(chunk.substr(first_newline + 1, last_newline - first_newline), options));
+         split_line.assign(chunk.substr(last_newline + 1));
+      },
+      chunk_size);
+   append(read_ndjson<T>(split_line, options));
+   return to_ret;
+}
+
+#endif // JSON_NDJSON_HPP
@@ -0,0 +1,133 @@
+#ifndef JSON_OUT_HPP
+#define JSON_OUT_HPP
+
+#include "json_simd.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Anything JSON text can be appended to; std::string qualifies as well as out_buffer
+template<typename T>
+concept json_output = requires(T& out, std::string_view v, char c) {
+   out.append(v);
+   out.push_back(c);
+};
+
+// Growable output buffer meant to be reused between documents; clear() keeps the allocation
+class out_buffer {
+public:
+   constexpr out_buffer() = default;
+
+   constexpr explicit out_buffer(std::size_t initial_capacity) { storage_.resize(initial_capacity); }
+
+   constexpr void append(const std::string_view v) { std::ranges::copy(v, grow(v.size())); }
+
+   constexpr void push_back(char c) { *grow(1) = c; }
+
+   // Room for n characters; commit() how many were actually written
+   constexpr char* reserve_tail(std::size_t n)
+   {
+      if (size_ + n > storage_.size()) {
+         storage_.resize(std::max(storage_.size() * 2, size_ + n));
+      }
+      return storage_.data() + size_;
+   }
+
+   constexpr void commit(std::size_t n) noexcept { size_ += n; }
+
+   constexpr void clear() noexcept { size_ = 0; }
+
+   constexpr std::string_view view() const noexcept { return {storage_.data(), size_}; }
+   constexpr std::size_t size() const noexcept { return size_; }
+
+private:
+   constexpr char* grow(std::size_t n)
+   {
+      const auto to_ret = reserve_tail(n);
+      commit(n);
+      return to_ret;
+   }
+
+   // Using the string's size as the capacity avoids a bounds check per character written
+   std::string storage_;
+   std::size_t size_ = 0;
+};
+
+namespace impl {
+
+inline constexpr char hex_digits[] = "0123456789abcdef";
+
+constexpr void append_escape(json_output auto& out, char c)
+{
+   switch (c) {
+   case '"': out.append("\\\""); break;
+   case '\\': out.append("\\\\"); break;
+   case '\b': out.append("\\b"); break;
+   case '\f': out.append("\\f"); break;
+   case '\n': out.append("\\n"); break;
+   case '\r': out.append("\\r"); break;
+   case '\t': out.append("\\t"); break;
+   default: {
+      const auto u = static_cast<unsigned char>(c);
+      const char escaped[] = {'\\', 'u', '0', '0', hex_digits[u >> 4], hex_digits[u & 0xF]};
+      out.append(std::string_view{escaped, sizeof(escaped)});
+      break;
+   }
+   }
+}
+
+} // namespace impl
+
+// Writes v as a quoted JSON string. Characters needing an escape are searched for 16 or 32 bytes at a time
+// and the runs between them are copied in one go.
+constexpr void write_json_string(json_output auto& out, const std::string_view v)
+{
+   out.push_back('"');
+   auto first = v.data();
+   const auto last = v.data() + v.size();
+   while (true) {
+      const auto special = find_escapable(first, last);
+      out.append(std::string_view{first, special});
+      if (special == last) {
+         break;
+      }
+      impl::append_escape(out, *special);
+      first = special + 1;
+   }
+   out.push_back('"');
+}
+
+template<typename T>
+   requires(std::integral<T> && !std::same_as<T, bool>)
+constexpr void write_json_number(json_output auto& out, T value)
+{
+   char buffer[24];
+   const auto [end, ec] = std::to_chars(std::begin(buffer), std::end(buffer), value);
+   out.append(std::string_view{buffer, end});
+}
+
+// JSON has no representation for infinities or NaN, so they're written as null
+template<std::floating_point T>
+constexpr void write_json_number(json_output auto& out, T value)
+{
+   if consteval {
+      throw std::runtime_error{"floating point numbers can only be written at run time"};
+   }
+   else {
+      if (!std::isfinite(value)) {
+         out.append("null");
+         return;
+      }
+      char buffer[32];
+      const auto [end, ec] = std::to_chars(std::begin(buffer), std::end(buffer), value);
+      out.append(std::string_view{buffer, end});
+   }
+}
+
+#endif // JSON_OUT_HPP
@@ -0,0 +1,96 @@
+#include "json_file.hpp"
+#include "json_format.hpp"
+#include "json_parse.hpp"
+#include "json_write.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Packs the "data" rows of a format file (see json_format.hpp) into <name>.bin, laid out as the struct
+// make_struct_from_json defines and in native byte order, for packed_rows to read in place. The format alone goes
+// to <name>.format.json, so the struct can be defined without the compiler parsing the data.
+//
+// Usage: json_pack <input.json> <output directory> <name>
+
+namespace {
+
+template<typename Int>
+void store(std::int64_t value, unsigned char* out)
+{
+   if constexpr (std::numeric_limits<Int>::max() < std::numeric_limits<std::int64_t>::max()) {
+      if (value > static_cast<std::int64_t>(std::numeric_limits<Int>::max())) {
+         throw std::runtime_error{"value too large for its format type"};
+      }
+   }
+   if (value < static_cast<std::int64_t>(std::numeric_limits<Int>::min())) {
+      throw std::runtime_error{"value too small for its format type"};
+   }
+   const auto as_int = static_cast<Int>(value);
+   std::memcpy(out, &as_int, sizeof(Int));
+}
+
+void store(std::int64_t value, const packed_type& type, unsigned char* out)
+{
+   switch (type.size) {
+   case 1: type.is_signed ? store<std::int8_t>(value, out) : store<std::uint8_t>(value, out); break;
+   case 2: type.is_signed ? store<std::int16_t>(value, out) : store<std::uint16_t>(value, out); break;
+   case 4: type.is_signed ? store<std::int32_t>(value, out) : store<std::uint32_t>(value, out); break;
+   default: type.is_signed ? store<std::int64_t>(value, out) : store<std::uint64_t>(value, out); break;
+   }
+}
+
+void write_file(const std::string& path, const void* data, std::size_t size)
+{
+   std::ofstream out{path, std::ios::binary};
+   out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+   if (!out) {
+      throw std::runtime_error{"couldn't write " + path};
+   }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+   if (argc != 4) {
+      std::println(stderr, "usage: {} <input.json> <output directory> <name>", argv[0]);
+      return 1;
+   }
+   try {
+      const json_file file{argv[1]};
+      json_string_arena arena;
+      const auto json = parse_json(file.view(), arena);
+      const auto& format = std::get<json_map>(get_by_key(std::get<json_map>(json), "format"));
+      const auto& data = std::get<json_array>(get_by_key(std::get<json_map>(json), "data"));
+      const auto layout = layout_of_format(format);
+
+      std::vector<unsigned char> image(data.size() * layout.size);
+      auto row_out = image.data();
+      for (const auto& row : data) {
+         const auto& members = std::get<json_map>(row);
+         for (const auto& member : layout.members) {
+            store(std::get<std::int64_t>(get_by_key(members, member.name)), member.type, row_out + member.offset);
+         }
+         row_out += layout.size;
+      }
+
+      const auto base = std::string{argv[2]} + "/" + argv[3];
+      write_file(base + ".bin", image.data(), image.size());
+      const auto format_json = to_json_string(
+         json_value{json_map{
+            {"format", json_value{format}},
+            {"row_size", static_cast<std::int64_t>(layout.size)},
+            {"rows", static_cast<std::int64_t>(data.size())}}});
+      write_file(base + ".format.json", format_json.data(), format_json.size());
+   }
+   catch (const std::exception& e) {
+      std::println(stderr, "json_pack: {}: {}", argv[1], e.what());
+      return 1;
+   }
+}
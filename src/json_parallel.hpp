@@ -0,0 +1,220 @@
+#ifndef JSON_PARALLEL_HPP
+#define JSON_PARALLEL_HPP
+
+#include "json_reflect.hpp"
+#include "json_simd.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <exception>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct parallel_options {
+   // 0 for one per hardware thread
+   std::size_t threads = 0;
+   // Input is split into pieces of about this many bytes, each run on to the next place it can be cut
+   std::size_t chunk_size = 1 << 20;
+};
+
+namespace impl {
+
+// Calls task(i) for every i below num_tasks, spread over the given number of threads. Tasks are claimed in
+// order and a claimed task always runs, so when one fails every task before it has already been claimed and will
+// still finish; only later ones are abandoned. The first failure in task order is rethrown, which is the one
+// running the tasks one after another would have hit.
+void run_tasks(std::size_t num_tasks, std::size_t threads, const auto& task)
+{
+   std::vector<std::exception_ptr> errors(num_tasks);
+   std::atomic<std::size_t> next_task = 0;
+   std::atomic<bool> failed = false;
+   const auto worker = [&] {
+      // failed is checked before claiming rather than after, which could drop a task claimed before the failure
+      while (!failed) {
+         const auto i = next_task++;
+         if (i >= num_tasks) {
+            break;
+         }
+         try {
+            task(i);
+         }
+         catch (...) {
+            errors[i] = std::current_exception();
+            failed = true;
+         }
+      }
+   };
+
+   const auto hardware_threads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+   const auto num_threads = std::min(threads != 0 ? threads : hardware_threads, num_tasks);
+   {
+      std::vector<std::jthread> workers;
+      for (std::size_t i = 1; i < num_threads; ++i) {
+         workers.emplace_back(worker);
+      }
+      worker();
+   }
+
+   for (const auto& error : errors) {
+      if (error) {
+         std::rethrow_exception(error);
+      }
+   }
+}
+
+// Consecutive elements of an array: the text from the start of the first to the end of the last, commas
+// between them included
+struct array_chunk {
+   std::size_t begin;
+   std::size_t end;
+   std::size_t count;
+};
+
+// Cuts the elements of an array into chunks. The array is the root of the input if key is empty, otherwise the
+// value of key in the root object. What's around the array is read as from_json would read it, so input that
+// from_json rejects for what's outside the array is rejected here too. The array itself is only scanned for
+// structural characters, with positions tracked as 64-bit offsets, so this works on inputs past the 4 GiB limit
+// of find_structural_indexes and in memory proportional to the number of chunks. Elements themselves are left
+// for the reader to validate.
+constexpr std::vector<array_chunk> split_json_array(
+   const std::string_view input, const std::string_view key, std::size_t chunk_size)
+{
+   auto cursor = json_cursor{input};
+   if (!key.empty()) {
+      cursor.seek_member(key);
+   }
+   if (cursor.peek() != '[') {
+      throw std::runtime_error{"expected a JSON array"};
+   }
+
+   std::vector<array_chunk> to_ret;
+   array_chunk current{};
+   std::size_t depth = 0;
+   bool at_element_start = true;
+   bool seen_element = false;
+
+   // Returns true once the array is closed
+   const auto visit = [&](std::size_t pos) {
+      const auto c = input[pos];
+      if (depth == 1) {
+         if (c == ']') {
+            if (at_element_start && seen_element) {
+               throw std::runtime_error{"unexpected token after array value"};
+            }
+            if (current.count != 0) {
+               current.end = pos;
+               to_ret.push_back(current);
+            }
+            return true;
+         }
+         if (c == ',') {
+            if (at_element_start) {
+               throw std::runtime_error{"unexpected token after array value"};
+            }
+            if (pos - current.begin >= chunk_size) {
+               current.end = pos;
+               to_ret.push_back(current);
+               current = {};
+            }
+            at_element_start = true;
+            return false;
+         }
+         if (c == '}') {
+            throw std::runtime_error{"expected ']' in JSON input"};
+         }
+         if (at_element_start) {
+            current.begin = current.count == 0 ? pos : current.begin;
+            current.count += 1;
+            seen_element = true;
+            at_element_start = false;
+         }
+      }
+
+      if (c == '{' || c == '[') {
+         depth += 1;
+      }
+      else if (c == '}' || c == ']') {
+         depth -= 1;
+      }
+      return false;
+   };
+
+   // The scan starts at the array's '[', which is outside any string, so it needs nothing from what's before it
+   const auto array_begin = cursor.pos;
+   structural_scanner scanner;
+   for (std::size_t base = array_begin; base < input.size(); base += 64) {
+      std::uint64_t bits;
+      if (base + 64 <= input.size()) {
+         bits = scanner.scan(input.data() + base);
+      }
+      else {
+         // Pad the tail with whitespace, which is never structural
+         char tail[64];
+         std::ranges::fill(tail, ' ');
+         std::ranges::copy(input.substr(base), tail);
+         bits = scanner.scan(tail);
+      }
+      if (scanner.utf8.failed()) {
+         throw std::runtime_error{"invalid UTF-8"};
+      }
+      for (; bits != 0; bits &= bits - 1) {
+         const auto pos = base + static_cast<std::size_t>(std::countr_zero(bits));
+         if (visit(pos)) {
+            cursor.pos = pos + 1;
+            if (!key.empty()) {
+               cursor.skip_object_rest();
+            }
+            if (!cursor.at_end()) {
+               throw std::runtime_error{"unexpected data after end of JSON object"};
+            }
+            return to_ret;
+         }
+      }
+   }
+   throw std::runtime_error{"unexpected end of JSON input"};
+}
+
+} // namespace impl
+
+// The elements of one large array, read as Ts on several threads: the root of input if it's an array, or the
+// value of key in the root object, e.g., {"data": [...]}. A serial pass finds where the elements are, then
+// chunks of them are read in parallel into a vector allocated once up front. Each element is read as from_json
+// would read it, and the rest of the document is checked the same way, so for a document that has key once the
+// result, or whether it's rejected, is the same as for a serial parse.
+template<typename T>
+std::vector<T> read_json_array(const std::string_view input, const std::string_view key, parallel_options options = {})
+{
+   const auto chunks = impl::split_json_array(input, key, options.chunk_size);
+   std::vector<std::size_t> offsets;
+   std::size_t total = 0;
+   for (const auto& chunk : chunks) {
+      offsets.push_back(total);
+      total += chunk.count;
+   }
+   std::vector<T> to_ret(total);
+   impl::run_tasks(chunks.size(), options.threads, [&](std::size_t i) {
+      const auto [begin, end, count] = chunks[i];
+      auto cursor = json_cursor{input.substr(begin, end - begin)};
+      for (std::size_t j = 0; j < count; ++j) {
+         if (j != 0) {
+            cursor.expect(',');
+         }
+         impl::read_json_value(cursor, to_ret[offsets[i] + j]);
+      }
+      if (!cursor.at_end()) {
+         throw std::runtime_error{"unexpected token after array value"};
+      }
+   });
+   return to_ret;
+}
+
+template<typename T>
+std::vector<T> read_json_array(const std::string_view input, parallel_options options = {})
+{
+   return read_json_array<T>(input, {}, options);
+}
+
+#endif // JSON_PARALLEL_HPP
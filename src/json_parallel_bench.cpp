@@ -0,0 +1,198 @@
+#include "json_ndjson.hpp"
+#include "json_parallel.hpp"
+#include "json_rows.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+// Records per second for read_ndjson and read_json_array with one thread and with one per hardware thread, and
+// for rows, and checks that every variant gives the same records as a serial parse and reports the same bad record
+
+struct point {
+   std::int32_t x;
+   std::int32_t y;
+   std::string label;
+};
+
+std::string make_record(std::size_t i)
+{
+   const auto x = static_cast<std::int32_t>(i);
+   return std::format(R"({{"x": {}, "y": {}, "label": "p{}"}})", x, -x, i % 1000);
+}
+
+std::string make_lines(std::size_t num_records)
+{
+   std::string to_ret;
+   for (std::size_t i = 0; i < num_records; ++i) {
+      to_ret += make_record(i);
+      to_ret += i % 16 == 0 ? "\r\n" : "\n";
+   }
+   return to_ret;
+}
+
+// The shape make_data_from_json in json_format.hpp reads, with "format" ahead of the data
+std::string make_array_document(std::size_t num_records)
+{
+   std::string to_ret = R"({"format": {"x": "i32", "y": "i32", "label": "str"}, "data": [)";
+   for (std::size_t i = 0; i < num_records; ++i) {
+      to_ret += i == 0 ? "\n" : ",\n";
+      to_ret += make_record(i);
+   }
+   to_ret += "\n]}";
+   return to_ret;
+}
+
+void check_same(const std::vector<point>& expected, const std::vector<point>& actual)
+{
+   assert(expected.size() == actual.size());
+   for (std::size_t i = 0; i < expected.size(); ++i) {
+      assert(expected[i].x == actual[i].x && expected[i].y == actual[i].y && expected[i].label == actual[i].label);
+   }
+}
+
+std::string error_from(const auto& read)
+{
+   try {
+      read();
+   }
+   catch (const std::runtime_error& e) {
+      return e.what();
+   }
+   return {};
+}
+
+double records_per_sec(std::size_t num_records, auto from, auto to)
+{
+   return static_cast<double>(num_records) / std::chrono::duration<double>(to - from).count();
+}
+
+int main()
+{
+   constexpr std::size_t num_records = 10'000'000;
+   const auto threads = std::thread::hardware_concurrency();
+
+   const auto lines = make_lines(num_records);
+   const auto lines_start = std::chrono::steady_clock::now();
+   const auto serial_lines = read_ndjson<point>(lines, {.threads = 1});
+   const auto lines_middle = std::chrono::steady_clock::now();
+   const auto parallel_lines = read_ndjson<point>(lines);
+   const auto lines_stop = std::chrono::steady_clock::now();
+   check_same(serial_lines, parallel_lines);
+   assert(parallel_lines.back().x == static_cast<std::int32_t>(num_records - 1));
+   assert(parallel_lines.back().label == "p999");
+
+   // A few of the same lines through a pipe, written and read in pieces shorter than a record, so most chunks have
+   // no newline in them and every record is split. The last line has no newline at all.
+   auto piped_lines = make_lines(1000);
+   piped_lines.pop_back();
+   int pipe_fds[2];
+   if (::pipe(pipe_fds) != 0) {
+      throw std::runtime_error{"couldn't create a pipe"};
+   }
+   std::jthread writer{[&] {
+      for (std::size_t i = 0; i < piped_lines.size();) {
+         const auto count
+            = ::write(pipe_fds[1], piped_lines.data() + i, std::min<std::size_t>(piped_lines.size() - i, 5));
+         if (count <= 0) {
+            break;
+         }
+         i += static_cast<std::size_t>(count);
+      }
+      ::close(pipe_fds[1]);
+   }};
+   const auto streamed_lines = read_ndjson_stream<point>(pipe_fds[0], {}, 13);
+   writer.join();
+   ::close(pipe_fds[0]);
+   check_same(read_ndjson<point>(piped_lines), streamed_lines);
+   assert(streamed_lines.size() == 1000);
+
+   const auto document = make_array_document(num_records);
+   struct data_holder {
+      std::vector<point> data;
+   };
+   const auto array_start = std::chrono::steady_clock::now();
+   const auto serial_array = from_json<data_holder>(document).data;
+   const auto array_middle = std::chrono::steady_clock::now();
+   const auto parallel_array = read_json_array<point>(document, "data");
+   const auto array_stop = std::chrono::steady_clock::now();
+   check_same(serial_array, parallel_array);
+   check_same(serial_lines, parallel_array);
+
+   // One record in memory at a time, as a filter over the rows would see them
+   std::size_t row_index = 0;
+   for (const auto& row : rows<point>(document)) {
+      const auto& expected = serial_array[row_index++];
+      assert(row.x == expected.x && row.y == expected.y && row.label == expected.label);
+   }
+   assert(row_index == num_records);
+   const auto rows_stop = std::chrono::steady_clock::now();
+
+   // The later of two failing tasks fails first; the earlier one was claimed before that, so it still runs and is
+   // the error reported
+   std::atomic<bool> later_failed = false;
+   const auto task_error = error_from([&] {
+      impl::run_tasks(4, 4, [&](std::size_t i) {
+         if (i == 1) {
+            while (!later_failed) {
+               std::this_thread::yield();
+            }
+            throw std::runtime_error{"task 1"};
+         }
+         if (i == 2) {
+            later_failed = true;
+            throw std::runtime_error{"task 2"};
+         }
+      });
+   });
+   assert(task_error == "task 1");
+
+   // Two records that fail differently, in different chunks; the earlier one should always be the one reported
+   auto bad_lines = lines;
+   const auto first_bad = bad_lines.find('\n', bad_lines.size() / 3) + 1;
+   bad_lines[first_bad] = '#';
+   bad_lines[bad_lines.find('\n', bad_lines.size() / 2) - 1] = ',';
+   const auto first_bad_end = bad_lines.find('\n', first_bad);
+   const auto expected_error
+      = error_from([&] { from_json<point>(std::string_view{bad_lines}.substr(first_bad, first_bad_end - first_bad)); });
+   assert(!expected_error.empty());
+   assert(error_from([&] { read_ndjson<point>(bad_lines, {.threads = 1}); }) == expected_error);
+   assert(error_from([&] { read_ndjson<point>(bad_lines, {.chunk_size = 4096}); }) == expected_error);
+
+   auto bad_document = document;
+   bad_document[bad_document.find('\n', bad_document.size() / 3) + 1] = '#';
+   bad_document[bad_document.find('\n', bad_document.size() / 2) - 1] = ':';
+   const auto expected_array_error = error_from([&] { from_json<data_holder>(bad_document); });
+   assert(!expected_array_error.empty());
+   const auto array_error = error_from([&] { read_json_array<point>(bad_document, "data", {.chunk_size = 4096}); });
+   assert(array_error == expected_array_error);
+
+   // Garbage after the array, or a root object that's never closed, is rejected like from_json rejects it
+   for (const auto& bad_end : {document + "]", document.substr(0, document.size() - 1)}) {
+      assert(!error_from([&] { from_json<data_holder>(bad_end); }).empty());
+      assert(!error_from([&] { read_json_array<point>(bad_end, "data"); }).empty());
+   }
+
+   std::println("{} records", num_records);
+   std::println(
+      "JSON Lines, 1 thread: {:.2f}M records/s", records_per_sec(num_records, lines_start, lines_middle) / 1e6);
+   std::println(
+      "JSON Lines, {} threads: {:.2f}M records/s",
+      threads,
+      records_per_sec(num_records, lines_middle, lines_stop) / 1e6);
+   std::println(
+      "array, from_json: {:.2f}M records/s", records_per_sec(num_records, array_start, array_middle) / 1e6);
+   std::println(
+      "array, {} threads: {:.2f}M records/s", threads, records_per_sec(num_records, array_middle, array_stop) / 1e6);
+   std::println("array, a row at a time: {:.2f}M records/s", records_per_sec(num_records, array_stop, rows_stop) / 1e6);
+}
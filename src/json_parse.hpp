@@ -1,7 +1,8 @@
 #ifndef JSON_PARSE_HPP
 #define JSON_PARSE_HPP
 
-#include <charconv>
+#include "json_sax.hpp"
+
 #include <cstdint>
 #include <stdexcept>
 #include <string_view>
@@ -29,6 +30,7 @@
 struct json_value
    : std::variant<
         std::int64_t,
+        double,
         bool,
         std::nullptr_t,
         std::string_view,
@@ -37,6 +39,7 @@ struct json_value
 private:
    using base = std::variant<
       std::int64_t,
+      double,
       bool,
       std::nullptr_t,
       std::string_view,
@@ -50,8 +53,22 @@ public:
 using json_array = std::vector<json_value>;
 using json_map = std::vector<std::pair<std::string_view, json_value>>;
 
+namespace impl {
+
+constexpr std::uint64_t hash_name(const std::string_view name) noexcept
+{
+   // FNV-1a
+   std::uint64_t to_ret = 0xcbf2'9ce4'8422'2325;
+   for (const auto c : name) {
+      to_ret = (to_ret ^ static_cast<unsigned char>(c)) * 0x0000'0100'0000'01b3;
+   }
+   return to_ret;
+}
+
+} // namespace impl
+
 template<typename Range>
-consteval const std::ranges::range_value_t<Range>::second_type* get_by_key_opt(Range&& vals, const std::string_view key)
+constexpr const std::ranges::range_value_t<Range>::second_type* get_by_key_opt(Range&& vals, const std::string_view key)
 {
    for (auto&& [comp_key, value] : vals) {
       if (comp_key == key) {
@@ -62,7 +79,7 @@ consteval const std::ranges::range_value_t<Range>::second_type* get_by_key_opt(R
 }
 
 template<typename Range>
-consteval const std::ranges::range_value_t<Range>::second_type& get_by_key(Range&& vals, const std::string_view key)
+constexpr const std::ranges::range_value_t<Range>::second_type& get_by_key(Range&& vals, const std::string_view key)
 {
    if (const auto val = get_by_key_opt(std::forward<Range>(vals), key)) {
       return *val;
@@ -90,120 +107,72 @@ struct one_of_struct {
 template<auto... Values>
 constexpr auto one_of = one_of_struct<Values...>{};
 
-constexpr std::string_view strip_leading_whitespace(const std::string_view v)
-{
-   std::size_t index = 0;
-   while (index < v.size() && v[index] == one_of<' ', '\f', '\n', '\r', '\t', '\v'>) {
-      index += 1;
-   }
-   return v.substr(index);
-}
+namespace impl {
 
-// Pre: leading whitespace has been removed
-// First is the key, second is rest
-consteval std::pair<std::string_view, std::string_view> parse_json_str(const std::string_view v)
-{
-   std::size_t rest = 1;
-   while (true) {
-      const auto next = v.find('"', rest);
-      if (next == std::string_view::npos) {
-         throw std::runtime_error{"unterminated string"};
-      }
-      if (v[next - 1] != '\\') {
-         rest = next;
-         break;
-      }
-      rest = next;
-   }
-   return {v.substr(1, rest - 1), v.substr(rest + 1)};
-}
+// Builds the tree from parse_json_events; open containers are kept on a stack until they're closed
+class dom_builder {
+public:
+   constexpr void on_object_begin() { open_.emplace_back(json_map{}); }
+   constexpr void on_array_begin() { open_.emplace_back(json_array{}); }
+   constexpr void on_object_end() { close(); }
+   constexpr void on_array_end() { close(); }
+   constexpr void on_key(const std::string_view key) { keys_.push_back(key); }
+   constexpr void on_string(const std::string_view v) { add(v); }
+   constexpr void on_int64(std::int64_t v) { add(v); }
+   constexpr void on_double(double v) { add(v); }
+   constexpr void on_bool(bool v) { add(v); }
+   constexpr void on_null() { add(nullptr); }
 
-// Pre: leading whitespace has been removed
-consteval std::pair<json_value, std::string_view> parse_json_value(const std::string_view v)
-{
-   if (v.starts_with("true")) {
-      return {true, v.substr(4)};
-   }
-   else if (v.starts_with("false")) {
-      return {false, v.substr(5)};
-   }
-   else if (v.starts_with("null")) {
-      return {nullptr, v.substr(4)};
-   }
-   else if (v.front() == '-' || (v.front() >= '0' && v.front() <= '9')) {
-      // number
-      std::int64_t value;
-      const auto [rest, ec] = std::from_chars(v.data(), v.data() + v.size(), value);
-      if (ec != std::errc{}) {
-         throw std::runtime_error{"number parse error"};
+   constexpr json_value& result() noexcept { return result_; }
+
+private:
+   constexpr void add(json_value v)
+   {
+      if (open_.empty()) {
+         result_ = std::move(v);
       }
-      return {value, {rest, v.data() + v.size()}};
-   }
-   else if (v.front() == '"') {
-      // string
-      return parse_json_str(v);
-   }
-   else if (v.front() == '{') {
-      // object
-      const auto next = strip_leading_whitespace(v.substr(1));
-      if (next.front() != '"') {
-         throw std::runtime_error{"expected string for JSON key"};
+      else if (const auto map = std::get_if<json_map>(&open_.back())) {
+         map->emplace_back(keys_.back(), std::move(v));
+         keys_.pop_back();
       }
-      auto next_key = next;
-      // std::map<std::string_view, json_value> vals;
-      std::vector<std::pair<std::string_view, json_value>> vals;
-      while (true) {
-         const auto [key, rest] = parse_json_str(next_key);
-         const auto colon_next = strip_leading_whitespace(rest);
-         if (colon_next.front() != ':') {
-            throw std::runtime_error{"expected colon after JSON key"};
-         }
-         const auto [value, end_value_str] = parse_json_value(strip_leading_whitespace(colon_next.substr(1)));
-         // vals.emplace(key, value);
-         vals.emplace_back(key, value);
-         const auto end = strip_leading_whitespace(end_value_str);
-         next_key = end;
-         if (end.front() == '}') {
-            return {vals, end.substr(1)};
-         }
-         else if (end.front() == ',') {
-            next_key = strip_leading_whitespace(end.substr(1));
-         }
-         else {
-            throw std::runtime_error{"unexpected token after dict value"};
-         }
+      else {
+         std::get<json_array>(open_.back()).push_back(std::move(v));
       }
    }
-   else if (v.front() == '[') {
-      // array
-      auto next_val = strip_leading_whitespace(v.substr(1));
-      std::vector<json_value> vals;
-      while (true) {
-         const auto [value, end_val] = parse_json_value(next_val);
-         vals.push_back(value);
-         const auto end = strip_leading_whitespace(end_val);
-         if (end.front() == ']') {
-            return {vals, end.substr(1)};
-         }
-         else if (end.front() == ',') {
-            next_val = strip_leading_whitespace(end.substr(1));
-         }
-         else {
-            throw std::runtime_error{"unexpected token after array value"};
-         }
-      }
+
+   constexpr void close()
+   {
+      auto done = std::move(open_.back());
+      open_.pop_back();
+      add(std::move(done));
    }
-   throw std::runtime_error{"unexpected token"};
+
+   std::vector<json_value> open_;
+   std::vector<std::string_view> keys_;
+   json_value result_;
+};
+
+} // namespace impl
+
+// The input goes through a structural scan 64 bytes at a time (see json_simd.hpp) rather than being walked byte
+// by byte. At run time on AVX2 or SSE4.2 targets the blocks are classified with vector instructions; at compile
+// time, and on other targets, the same scan runs on scalar code. Nesting is tracked on an explicit stack, so deep
+// documents are limited by options.max_depth rather than by recursion. The returned value refers to v, which must
+// outlive it.
+constexpr json_value parse_json(const std::string_view v, parse_options options = {})
+{
+   impl::dom_builder builder;
+   parse_json_events(v, builder, options);
+   return std::move(builder.result());
 }
 
-consteval json_value parse_json(const std::string_view v)
+// As above, but escaped strings and keys are decoded into arena, which must also outlive the result. Strings
+// without escape sequences are still views of v, so the common case copies nothing.
+constexpr json_value parse_json(const std::string_view v, json_string_arena& arena, parse_options options = {})
 {
-   const auto [value, rest] = parse_json_value(strip_leading_whitespace(v));
-   const auto no_ws_end = strip_leading_whitespace(rest);
-   if (!no_ws_end.empty()) {
-      throw std::runtime_error{"unexpected data after end of JSON object"};
-   }
-   return value;
+   impl::dom_builder builder;
+   parse_json_events(v, builder, arena, options);
+   return std::move(builder.result());
 }
 
 #endif // JSON_PARSE_HPP
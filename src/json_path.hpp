@@ -0,0 +1,480 @@
+#ifndef JSON_PATH_HPP
+#define JSON_PATH_HPP
+
+#include "common.hpp"
+#include "json_lazy.hpp"
+#include "json_parse.hpp"
+#include "json_simd.hpp"
+#include "json_string.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+// Paths into a document, compiled once into a list of steps so that pulling the same value out of many documents
+// doesn't go back over the path's text each time. A step is a key, and also an array index if the key is one, so
+// "/a/0" finds "a"'s first element if it's an array and its "0" member if it's an object, as RFC 6901 specifies.
+// A path evaluates against a json_value, a lazy_value or the raw text of a document, where only as much of the
+// input is scanned as it takes to find the value.
+
+namespace impl {
+
+struct path_step {
+   std::size_t key_begin;
+   std::size_t key_size;
+   // std::string_view::npos when the key isn't an array index
+   std::size_t index;
+};
+
+// "0", or digits without a leading zero
+constexpr std::size_t parse_path_index(const std::string_view token) noexcept
+{
+   if (token.empty() || token.size() > 19 || (token.size() > 1 && token[0] == '0')) {
+      return std::string_view::npos;
+   }
+   std::size_t to_ret = 0;
+   for (const auto c : token) {
+      if (c < '0' || c > '9') {
+         return std::string_view::npos;
+      }
+      to_ret = to_ret * 10 + static_cast<std::size_t>(c - '0');
+   }
+   return to_ret;
+}
+
+// The URI fragment form of a pointer has its characters percent-encoded
+constexpr std::string percent_decode(const std::string_view text)
+{
+   const auto hex_value = [](char c) -> int {
+      const auto lower = static_cast<char>(c | 0x20);
+      if (c >= '0' && c <= '9') {
+         return c - '0';
+      }
+      if (lower >= 'a' && lower <= 'f') {
+         return lower - 'a' + 10;
+      }
+      throw std::runtime_error{"invalid JSON path"};
+   };
+   std::string to_ret;
+   for (std::size_t i = 0; i < text.size(); ++i) {
+      if (text[i] != '%') {
+         to_ret += text[i];
+         continue;
+      }
+      if (i + 2 >= text.size()) {
+         throw std::runtime_error{"invalid JSON path"};
+      }
+      to_ret += static_cast<char>(hex_value(text[i + 1]) * 16 + hex_value(text[i + 2]));
+      i += 2;
+   }
+   return to_ret;
+}
+
+// The value of the four hex digits at raw[at], or std::nullopt if there aren't four
+constexpr std::optional<std::uint32_t> read_hex4(const std::string_view raw, const std::size_t at) noexcept
+{
+   if (at + 4 > raw.size()) {
+      return std::nullopt;
+   }
+   std::uint32_t to_ret = 0;
+   for (const char c : raw.substr(at, 4)) {
+      const auto lower = static_cast<char>(c | 0x20);
+      if (c >= '0' && c <= '9') {
+         to_ret = to_ret * 16 + static_cast<std::uint32_t>(c - '0');
+      }
+      else if (lower >= 'a' && lower <= 'f') {
+         to_ret = to_ret * 16 + static_cast<std::uint32_t>(lower - 'a' + 10);
+      }
+      else {
+         return std::nullopt;
+      }
+   }
+   return to_ret;
+}
+
+// Keys in raw text still have their escape sequences, which can only make them longer than the decoded key. They
+// are decoded one at a time as they're compared, so nothing is allocated, and a key that isn't validly escaped
+// matches nothing rather than throwing.
+constexpr bool raw_key_matches(const std::string_view raw, const std::string_view key) noexcept
+{
+   if (raw.size() < key.size()) {
+      return false;
+   }
+   if (raw.find('\\') == std::string_view::npos) {
+      return raw == key;
+   }
+   std::size_t matched = 0;
+   for (std::size_t i = 0; i < raw.size();) {
+      char decoded[4]{raw[i]};
+      std::size_t size = 1;
+      if (raw[i] != '\\') {
+         i += 1;
+      }
+      else if (i + 1 == raw.size()) {
+         return false;
+      }
+      else {
+         const auto escape = raw[i + 1];
+         i += 2;
+         switch (escape) {
+         case '"': decoded[0] = '"'; break;
+         case '\\': decoded[0] = '\\'; break;
+         case '/': decoded[0] = '/'; break;
+         case 'b': decoded[0] = '\b'; break;
+         case 'f': decoded[0] = '\f'; break;
+         case 'n': decoded[0] = '\n'; break;
+         case 'r': decoded[0] = '\r'; break;
+         case 't': decoded[0] = '\t'; break;
+         case 'u': {
+            auto code_point = read_hex4(raw, i);
+            if (!code_point) {
+               return false;
+            }
+            i += 4;
+            if (*code_point >= 0xD800 && *code_point < 0xDC00) {
+               const auto low = raw.substr(i).starts_with("\\u") ? read_hex4(raw, i + 2) : std::nullopt;
+               if (!low || *low < 0xDC00 || *low >= 0xE000) {
+                  return false;
+               }
+               code_point = 0x10000 + ((*code_point - 0xD800) << 10) + (*low - 0xDC00);
+               i += 6;
+            }
+            else if (*code_point >= 0xDC00 && *code_point < 0xE000) {
+               return false;
+            }
+            size = static_cast<std::size_t>(encode_utf8(decoded, *code_point) - decoded);
+            break;
+         }
+         default: return false;
+         }
+      }
+      if (key.substr(matched, size) != std::string_view{decoded, size}) {
+         return false;
+      }
+      matched += size;
+   }
+   return matched == key.size();
+}
+
+// A key of a json_value, which is decoded if the document was parsed with a json_string_arena and otherwise
+// still has its escape sequences, so it's compared both ways
+constexpr bool held_key_matches(const std::string_view held, const std::string_view key) noexcept
+{
+   return held == key || raw_key_matches(held, key);
+}
+
+} // namespace impl
+
+// The steps of a compiled path, whichever way it was compiled. Only valid while the path it came from is.
+struct json_path_view {
+   std::string_view keys;
+   std::span<const impl::path_step> steps;
+
+   constexpr std::size_t size() const noexcept { return steps.size(); }
+
+   constexpr std::string_view key(std::size_t i) const noexcept
+   {
+      return keys.substr(steps[i].key_begin, steps[i].key_size);
+   }
+
+   constexpr std::size_t index(std::size_t i) const noexcept { return steps[i].index; }
+};
+
+class json_path {
+public:
+   constexpr json_path() = default;
+
+   // An RFC 6901 pointer such as "/a/b/3", or "" for the whole document; its URI fragment form, "#/a/b/3"; or a
+   // dotted path, "a.b[3].c". Dotted keys can't contain '.', '[' or ']'.
+   constexpr explicit json_path(const std::string_view path)
+   {
+      if (path.starts_with('#')) {
+         parse_pointer(impl::percent_decode(path.substr(1)));
+      }
+      else if (path.empty() || path.starts_with('/')) {
+         parse_pointer(path);
+      }
+      else {
+         parse_dotted(path);
+      }
+   }
+
+   constexpr json_path_view view() const noexcept { return {keys_, steps_}; }
+   constexpr operator json_path_view() const noexcept { return view(); }
+
+   constexpr std::size_t size() const noexcept { return steps_.size(); }
+   constexpr std::string_view key(std::size_t i) const noexcept { return view().key(i); }
+   constexpr std::size_t index(std::size_t i) const noexcept { return steps_[i].index; }
+
+private:
+   constexpr void parse_pointer(const std::string_view path)
+   {
+      if (path.empty()) {
+         return;
+      }
+      if (path[0] != '/') {
+         throw std::runtime_error{"invalid JSON path"};
+      }
+      auto begin = keys_.size();
+      for (std::size_t i = 1; i < path.size(); ++i) {
+         if (path[i] == '/') {
+            add_step(begin);
+            begin = keys_.size();
+         }
+         else if (path[i] != '~') {
+            keys_ += path[i];
+         }
+         else if (i + 1 < path.size() && (path[i + 1] == '0' || path[i + 1] == '1')) {
+            keys_ += path[++i] == '0' ? '~' : '/';
+         }
+         else {
+            throw std::runtime_error{"invalid JSON path"};
+         }
+      }
+      add_step(begin);
+   }
+
+   constexpr void parse_dotted(const std::string_view path)
+   {
+      std::size_t i = 0;
+      while (i < path.size()) {
+         const auto begin = keys_.size();
+         if (path[i] == '[') {
+            const auto close = path.find(']', i);
+            if (close == std::string_view::npos) {
+               throw std::runtime_error{"invalid JSON path"};
+            }
+            keys_.append(path.substr(i + 1, close - i - 1));
+            add_step(begin);
+            if (steps_.back().index == std::string_view::npos) {
+               throw std::runtime_error{"invalid JSON path"};
+            }
+            i = close + 1;
+            continue;
+         }
+         if (!steps_.empty() && path[i++] != '.') {
+            throw std::runtime_error{"invalid JSON path"};
+         }
+         const auto end = std::min(path.find_first_of(".[]", i), path.size());
+         if (end == i) {
+            throw std::runtime_error{"invalid JSON path"};
+         }
+         keys_.append(path.substr(i, end - i));
+         add_step(begin);
+         i = end;
+      }
+   }
+
+   // The step's key is everything appended to keys_ since begin
+   constexpr void add_step(std::size_t begin)
+   {
+      const auto size = keys_.size() - begin;
+      steps_.push_back({begin, size, impl::parse_path_index(std::string_view{keys_}.substr(begin))});
+   }
+
+   std::string keys_;
+   std::vector<impl::path_step> steps_;
+};
+
+namespace impl {
+
+template<std::size_t NumSteps, std::size_t NumChars>
+struct fixed_json_path {
+   std::array<char, NumChars> keys;
+   std::array<path_step, NumSteps> steps;
+
+   constexpr operator json_path_view() const noexcept { return {{keys.data(), NumChars}, steps}; }
+};
+
+} // namespace impl
+
+// A path compiled while the program is, e.g., get_by_path(value, compiled_json_path<"/data/0/id">)
+template<fixed_string Path>
+constexpr auto compiled_json_path = [] {
+   constexpr auto sizes = [] {
+      const json_path path{Path.view()};
+      return std::array{path.size(), path.view().keys.size()};
+   }();
+   const json_path path{Path.view()};
+   impl::fixed_json_path<sizes[0], sizes[1]> to_ret{};
+   std::ranges::copy(path.view().keys, to_ret.keys.begin());
+   std::ranges::copy(path.view().steps, to_ret.steps.begin());
+   return to_ret;
+}();
+
+// The value at path, or nullptr if there isn't one. Keys match whether or not the document was parsed with a
+// json_string_arena to decode them.
+constexpr const json_value* get_by_path_opt(const json_value& root, const json_path_view path)
+{
+   auto value = &root;
+   for (std::size_t i = 0; i < path.size() && value != nullptr; ++i) {
+      if (const auto map = std::get_if<json_map>(value)) {
+         const auto member = std::ranges::find_if(
+            *map, [&](const auto& entry) { return impl::held_key_matches(entry.first, path.key(i)); });
+         value = member != map->end() ? &member->second : nullptr;
+      }
+      else if (const auto array = std::get_if<json_array>(value)) {
+         value = path.index(i) < array->size() ? &(*array)[path.index(i)] : nullptr;
+      }
+      else {
+         value = nullptr;
+      }
+   }
+   return value;
+}
+
+constexpr const json_value& get_by_path(const json_value& root, const json_path_view path)
+{
+   if (const auto value = get_by_path_opt(root, path)) {
+      return *value;
+   }
+   throw std::runtime_error{"no value at JSON path"};
+}
+
+// Members and elements before the ones on the path are stepped over without being parsed
+constexpr std::optional<lazy_value> get_by_path_opt(const lazy_value& root, const json_path_view path)
+{
+   auto value = root;
+   for (std::size_t i = 0; i < path.size(); ++i) {
+      if (value.holds<lazy_map>()) {
+         const auto map = get<lazy_map>(value);
+         auto iter = map.begin();
+         while (iter != map.end() && !impl::raw_key_matches((*iter).first, path.key(i))) {
+            ++iter;
+         }
+         if (iter == map.end()) {
+            return std::nullopt;
+         }
+         value = (*iter).second;
+      }
+      else if (value.holds<lazy_array>()) {
+         const auto array = get<lazy_array>(value);
+         auto iter = array.begin();
+         for (auto index = path.index(i); index != 0 && iter != array.end(); --index) {
+            ++iter;
+         }
+         if (path.index(i) == std::string_view::npos || iter == array.end()) {
+            return std::nullopt;
+         }
+         value = *iter;
+      }
+      else {
+         return std::nullopt;
+      }
+   }
+   return value;
+}
+
+constexpr lazy_value get_by_path(const lazy_value& root, const json_path_view path)
+{
+   if (const auto value = get_by_path_opt(root, path)) {
+      return *value;
+   }
+   throw std::runtime_error{"no value at JSON path"};
+}
+
+// The text of the value at path in json, as lazy_value::source() would give it, or nullopt if there isn't one.
+// Structural positions are scanned a few blocks at a time as the path is followed, and scanning stops once the
+// value has been found, so nothing after it is looked at. As with the lazy document, malformed JSON is only
+// reported in the parts that are visited.
+constexpr std::optional<std::string_view> find_by_path(const std::string_view json, const json_path_view path)
+{
+   auto indexes = structural_index_stream{json, 4};
+
+   // Consumes the rest of the value that starts at first and returns the end of its text
+   const auto value_end = [&](std::uint32_t first) -> std::size_t {
+      switch (json[first]) {
+      case '"': return indexes.next() + 1;
+      case '{':
+      case '[': {
+         std::size_t depth = 1;
+         std::uint32_t last;
+         do {
+            last = indexes.next();
+            if (json[last] == '{' || json[last] == '[') {
+               depth += 1;
+            }
+            else if (json[last] == '}' || json[last] == ']') {
+               depth -= 1;
+            }
+         } while (depth != 0);
+         return last + 1;
+      }
+      case '}':
+      case ']':
+      case ',':
+      case ':': throw std::runtime_error{"unexpected token"};
+      default: {
+         // Scalars end at the next structural character, or at the end of the input
+         std::size_t last = indexes.peek();
+         while (last > first && impl::is_whitespace(json[last - 1])) {
+            last -= 1;
+         }
+         return last;
+      }
+      }
+   };
+
+   auto at = indexes.next();
+   for (std::size_t i = 0; i < path.size(); ++i) {
+      if (json[at] == '{') {
+         at = indexes.next();
+         if (json[at] == '}') {
+            return std::nullopt;
+         }
+         while (true) {
+            if (json[at] != '"') {
+               throw std::runtime_error{"expected string for JSON key"};
+            }
+            const auto close = indexes.next();
+            if (json[indexes.next()] != ':') {
+               throw std::runtime_error{"expected colon after JSON key"};
+            }
+            const auto value = indexes.next();
+            if (impl::raw_key_matches(json.substr(at + 1, close - at - 1), path.key(i))) {
+               at = value;
+               break;
+            }
+            value_end(value);
+            const auto sep = json[indexes.next()];
+            if (sep == '}') {
+               return std::nullopt;
+            }
+            if (sep != ',') {
+               throw std::runtime_error{"unexpected token after dict value"};
+            }
+            at = indexes.next();
+         }
+      }
+      else if (json[at] == '[' && path.index(i) != std::string_view::npos) {
+         at = indexes.next();
+         if (json[at] == ']') {
+            return std::nullopt;
+         }
+         for (auto index = path.index(i); index != 0; --index) {
+            value_end(at);
+            const auto sep = json[indexes.next()];
+            if (sep == ']') {
+               return std::nullopt;
+            }
+            if (sep != ',') {
+               throw std::runtime_error{"unexpected token after array value"};
+            }
+            at = indexes.next();
+         }
+      }
+      else {
+         return std::nullopt;
+      }
+   }
+   return json.substr(at, value_end(at) - at);
+}
+
+#endif // JSON_PATH_HPP
@@ -0,0 +1,256 @@
+#ifndef JSON_PUSH_HPP
+#define JSON_PUSH_HPP
+
+#include "json_sax.hpp"
+#include "json_simd.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct push_options {
+   // Accept any number of whitespace separated top level values, as in a log stream, rather than exactly one
+   bool multiple_values = false;
+   // As in parse_options
+   std::size_t max_depth = parse_options{}.max_depth;
+};
+
+// Parses input that arrives in pieces of any size, such as reads from a pipe, and calls the handler as soon as
+// each token is complete. Only tokens split across chunk boundaries are copied, so buffering is bounded by the
+// longest string or number rather than the document. Unlike parse_json_events, strings and keys handed to the
+// handler are only valid for the duration of the call.
+template<json_handler Handler>
+class json_push_parser {
+public:
+   constexpr explicit json_push_parser(Handler& handler, push_options options = {})
+      : handler_{handler}
+      , options_{options}
+   {
+   }
+
+   constexpr void feed(const std::string_view chunk)
+   {
+      std::size_t i = 0;
+      while (i < chunk.size()) {
+         if (state_ == state::in_string) {
+            i = feed_string(chunk, i);
+            continue;
+         }
+         if (state_ == state::in_scalar) {
+            i = feed_scalar(chunk, i);
+            continue;
+         }
+         const auto c = chunk[i];
+         i += 1;
+         if (impl::is_whitespace(c)) {
+            continue;
+         }
+         switch (state_) {
+         case state::top_level:
+         case state::value: start_value(c); break;
+         case state::array_first:
+            if (c == ']') {
+               close_container();
+            }
+            else {
+               start_value(c);
+            }
+            break;
+         case state::object_first:
+         case state::key:
+            if (c == '}' && state_ == state::object_first) {
+               close_container();
+            }
+            else if (c == '"') {
+               string_is_key_ = true;
+               state_ = state::in_string;
+            }
+            else {
+               throw std::runtime_error{"expected string for JSON key"};
+            }
+            break;
+         case state::colon:
+            if (c != ':') {
+               throw std::runtime_error{"expected colon after JSON key"};
+            }
+            state_ = state::value;
+            break;
+         case state::comma_or_end:
+            if (c == ',') {
+               state_ = containers_.back() == '{' ? state::key : state::value;
+            }
+            else if (c == (containers_.back() == '{' ? '}' : ']')) {
+               close_container();
+            }
+            else {
+               throw std::runtime_error{
+                  containers_.back() == '{' ? "unexpected token after dict value"
+                                            : "unexpected token after array value"};
+            }
+            break;
+         case state::done: throw std::runtime_error{"unexpected data after end of JSON object"};
+         default: break;
+         }
+      }
+   }
+
+   // Call once the input is exhausted; completes a trailing scalar and checks that nothing was left open
+   constexpr void finish()
+   {
+      if (state_ == state::in_scalar) {
+         end_scalar();
+      }
+      if (state_ == state::done || (state_ == state::top_level && options_.multiple_values)) {
+         return;
+      }
+      throw std::runtime_error{"unexpected end of JSON input"};
+   }
+
+   // Number of top level values completed so far
+   constexpr std::size_t values_completed() const noexcept { return values_completed_; }
+
+private:
+   enum class state : std::uint8_t {
+      top_level,
+      value,
+      array_first,
+      object_first,
+      key,
+      colon,
+      comma_or_end,
+      in_string,
+      in_scalar,
+      done,
+   };
+
+   constexpr void start_value(char c)
+   {
+      switch (c) {
+      case '{':
+         handler_.on_object_begin();
+         push_container('{');
+         state_ = state::object_first;
+         return;
+      case '[':
+         handler_.on_array_begin();
+         push_container('[');
+         state_ = state::array_first;
+         return;
+      case '"':
+         string_is_key_ = false;
+         state_ = state::in_string;
+         return;
+      case '}':
+      case ']':
+      case ',':
+      case ':': throw std::runtime_error{"unexpected token"};
+      default:
+         partial_.push_back(c);
+         state_ = state::in_scalar;
+         return;
+      }
+   }
+
+   constexpr void push_container(char c)
+   {
+      if (containers_.size() == options_.max_depth) {
+         throw std::runtime_error{"JSON nesting too deep"};
+      }
+      containers_.push_back(c);
+   }
+
+   constexpr void end_value()
+   {
+      if (!containers_.empty()) {
+         state_ = state::comma_or_end;
+         return;
+      }
+      values_completed_ += 1;
+      state_ = options_.multiple_values ? state::top_level : state::done;
+   }
+
+   constexpr void close_container()
+   {
+      if (containers_.back() == '{') {
+         handler_.on_object_end();
+      }
+      else {
+         handler_.on_array_end();
+      }
+      containers_.pop_back();
+      end_value();
+   }
+
+   // Returns where the string ended, or the chunk size if it continues in the next chunk
+   constexpr std::size_t feed_string(const std::string_view chunk, const std::size_t start)
+   {
+      auto i = start;
+      while (i < chunk.size()) {
+         if (escaped_) {
+            escaped_ = false;
+            i += 1;
+            continue;
+         }
+         i = chunk.find_first_of("\"\\", i);
+         if (i == std::string_view::npos) {
+            break;
+         }
+         if (chunk[i] == '\\') {
+            escaped_ = true;
+            i += 1;
+            continue;
+         }
+         // The common case of a string contained in one chunk is passed straight through
+         auto v = chunk.substr(start, i - start);
+         if (!partial_.empty()) {
+            partial_.append(v);
+            v = partial_;
+         }
+         if (string_is_key_) {
+            handler_.on_key(v);
+            state_ = state::colon;
+         }
+         else {
+            handler_.on_string(v);
+            end_value();
+         }
+         partial_.clear();
+         return i + 1;
+      }
+      partial_.append(chunk.substr(start));
+      return chunk.size();
+   }
+
+   constexpr std::size_t feed_scalar(const std::string_view chunk, const std::size_t start)
+   {
+      const auto end = chunk.find_first_of(" \f\n\r\t\v,:[]{}\"", start);
+      partial_.append(chunk.substr(start, end - start));
+      if (end == std::string_view::npos) {
+         return chunk.size();
+      }
+      end_scalar();
+      return end;
+   }
+
+   constexpr void end_scalar()
+   {
+      impl::emit_scalar(handler_, partial_);
+      partial_.clear();
+      end_value();
+   }
+
+   Handler& handler_;
+   push_options options_;
+   state state_ = state::top_level;
+   // '{' or '[' for each open container
+   std::vector<char> containers_;
+   // Scalars, and strings split across chunks, are collected here
+   std::string partial_;
+   bool string_is_key_ = false;
+   bool escaped_ = false;
+   std::size_t values_completed_ = 0;
+};
+
+#endif // JSON_PUSH_HPP
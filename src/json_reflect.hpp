@@ -0,0 +1,532 @@
+#ifndef JSON_REFLECT_HPP
+#define JSON_REFLECT_HPP
+
+#include "common.hpp"
+#include "json_cursor.hpp"
+#include "json_out.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <experimental/meta>
+#include <map>
+#include <optional>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+// Reads JSON straight into reflected aggregates and writes them back out; no json_value is ever built
+
+namespace impl {
+
+consteval bool is_specialization_of(std::meta::info type, std::meta::info templ)
+{
+   type = std::meta::dealias(type);
+   return std::meta::has_template_arguments(type) && std::meta::template_of(type) == templ;
+}
+
+// Types like additional_value that derive from a std::variant to be able to refer to themselves
+consteval std::meta::info variant_base_of(std::meta::info type)
+{
+   if (is_specialization_of(type, ^^std::variant)) {
+      return type;
+   }
+   if (std::meta::is_class_type(type)) {
+      for (const auto base : std::meta::bases_of(type, std::meta::access_context::unchecked())) {
+         if (is_specialization_of(std::meta::type_of(base), ^^std::variant)) {
+            return std::meta::type_of(base);
+         }
+      }
+   }
+   return std::meta::info{};
+}
+
+template<typename T>
+consteval bool is_string_map()
+{
+   return (is_specialization_of(^^T, ^^std::unordered_map) || is_specialization_of(^^T, ^^std::map))
+       && std::meta::dealias(std::meta::template_arguments_of(std::meta::dealias(^^T))[0]) == ^^std::string;
+}
+
+template<typename T>
+consteval json_kind kind_of()
+{
+   if constexpr (std::same_as<T, bool>) {
+      return json_kind::boolean;
+   }
+   else if constexpr (std::same_as<T, std::nullptr_t>) {
+      return json_kind::null;
+   }
+   else if constexpr (std::integral<T>) {
+      return json_kind::integer;
+   }
+   else if constexpr (std::floating_point<T>) {
+      return json_kind::number;
+   }
+   else if constexpr (std::same_as<T, std::string>) {
+      return json_kind::string;
+   }
+   else if constexpr (is_specialization_of(^^T, ^^std::vector)) {
+      return json_kind::array;
+   }
+   else {
+      return json_kind::object;
+   }
+}
+
+inline constexpr std::string_view additional_properties_name = "additional_properties";
+
+// Open addressing table from member name to member index, built once per type. Keys are matched by hash and
+// verified with a single string compare, rather than comparing against every member in turn.
+template<typename T>
+struct member_lookup {
+   static constexpr auto members
+      = ::define_static_array(std::meta::nonstatic_data_members_of(^^T, std::meta::access_context::unchecked()));
+
+   static constexpr auto names = []() {
+      std::array<std::string_view, members.size()> to_ret;
+      for (std::size_t i = 0; i < members.size(); ++i) {
+         to_ret[i] = std::meta::identifier_of(members[i]);
+      }
+      return to_ret;
+   }();
+
+   static constexpr std::size_t table_size = std::bit_ceil(members.size() * 2 + 1);
+
+   static constexpr std::size_t no_member = members.size();
+
+   static constexpr auto table = []() {
+      std::array<std::size_t, table_size> to_ret;
+      std::ranges::fill(to_ret, no_member);
+      for (std::size_t i = 0; i < names.size(); ++i) {
+         auto slot = hash_name(names[i]) & (table_size - 1);
+         while (to_ret[slot] != no_member) {
+            slot = (slot + 1) & (table_size - 1);
+         }
+         to_ret[slot] = i;
+      }
+      return to_ret;
+   }();
+
+   static constexpr std::size_t find(const std::string_view name) noexcept
+   {
+      auto slot = hash_name(name) & (table_size - 1);
+      while (table[slot] != no_member) {
+         if (names[table[slot]] == name) {
+            return table[slot];
+         }
+         slot = (slot + 1) & (table_size - 1);
+      }
+      return no_member;
+   }
+
+   static consteval bool has_additional_properties()
+   {
+      return std::ranges::find(names, additional_properties_name) != names.end();
+   }
+};
+
+template<typename T>
+constexpr void read_json_value(json_cursor& cursor, T& out);
+
+// What from_json gives a member that isn't in the input. The default T is made once rather than for every member
+// that's missing, so a reused object can be reset by assignment, which keeps its members' capacity.
+template<typename T>
+constexpr const T& default_value()
+{
+   static const T value{};
+   return value;
+}
+
+// Reads a JSON object into a string map that may hold the entries of an earlier value. Its nodes are taken out
+// first and put back as their keys are read again, so entries with the same keys as before are read in place and
+// allocate nothing; entries whose keys don't come up again are destroyed along with this. Maps of more than
+// max_reused entries are just cleared.
+template<typename Map>
+class reused_map_entries {
+public:
+   static constexpr std::size_t max_reused = 32;
+
+   constexpr explicit reused_map_entries(Map& map) : map_{map}
+   {
+      if (map.size() > max_reused) {
+         map.clear();
+         return;
+      }
+      while (!map.empty()) {
+         spare_[num_spare_++] = map.extract(map.begin());
+      }
+   }
+
+   // The value to read key's value into
+   constexpr typename Map::mapped_type& operator[](const std::string_view key)
+   {
+      for (std::size_t i = 0; i < num_spare_; ++i) {
+         if (!spare_[i].empty() && spare_[i].key() == key) {
+            return map_.insert(std::move(spare_[i])).position->second;
+         }
+      }
+      name_.assign(key);
+      return map_[name_];
+   }
+
+private:
+   Map& map_;
+   std::array<typename Map::node_type, max_reused> spare_;
+   std::size_t num_spare_ = 0;
+   std::string name_;
+};
+
+// out may hold an earlier value, as when rows reads every element into the same T, so the members an object didn't
+// have are reset once it's been read. The additional_properties map is left to reused_map_entries.
+template<typename T>
+constexpr void reset_unread_members(T& out, const std::array<bool, member_lookup<T>::members.size()>& read)
+{
+   using lookup = member_lookup<T>;
+   template for (constexpr auto i : ::define_static_array(std::views::iota(0zu, lookup::members.size())))
+   {
+      if constexpr (lookup::names[i] != additional_properties_name) {
+         if (!read[i]) {
+            if consteval {
+               out.[:lookup::members[i]:] = T{}.[:lookup::members[i]:];
+            }
+            else {
+               out.[:lookup::members[i]:] = default_value<T>().[:lookup::members[i]:];
+            }
+         }
+      }
+   }
+}
+
+template<typename T>
+constexpr void read_aggregate(json_cursor& cursor, T& out)
+{
+   using lookup = member_lookup<T>;
+   [[maybe_unused]] auto extra = [&] {
+      if constexpr (lookup::has_additional_properties()) {
+         return reused_map_entries{out.[:lookup::members[lookup::find(additional_properties_name)]:]};
+      }
+      else {
+         return nullptr;
+      }
+   }();
+   std::array<bool, lookup::members.size()> read{};
+   cursor.expect('{');
+   if (cursor.consume('}')) {
+      reset_unread_members(out, read);
+      return;
+   }
+   std::string key_scratch;
+   do {
+      const auto key = cursor.read_key(key_scratch);
+      const auto index = lookup::find(key);
+      if (index == lookup::no_member) {
+         if constexpr (lookup::has_additional_properties()) {
+            read_json_value(cursor, extra[key]);
+         }
+         else {
+            cursor.skip_value();
+         }
+         continue;
+      }
+      read[index] = true;
+      template for (constexpr auto i : ::define_static_array(std::views::iota(0zu, lookup::members.size())))
+      {
+         if (i == index) {
+            read_json_value(cursor, out.[:lookup::members[i]:]);
+         }
+      }
+   } while (cursor.consume(','));
+   cursor.expect('}');
+   reset_unread_members(out, read);
+}
+
+template<typename T>
+constexpr void read_variant(json_cursor& cursor, T& out)
+{
+   using base_type = [:variant_base_of(^^T):];
+   static constexpr auto alternatives
+      = ::define_static_array(std::meta::template_arguments_of(variant_base_of(^^T)));
+   const auto kind = cursor.peek_kind();
+   // An integer can still be stored in a floating point alternative
+   static constexpr auto has_integer = std::ranges::any_of(
+      alternatives, [](std::meta::info alt) { return std::meta::is_integral_type(alt) && alt != ^^bool; });
+   const auto use_kind = kind == json_kind::integer && !has_integer ? json_kind::number : kind;
+   template for (constexpr auto alt : alternatives)
+   {
+      using alt_type = [:alt:];
+      if (use_kind == kind_of<alt_type>()) {
+         // Read in place if out already holds a value of this kind, to keep its capacity
+         auto& base = static_cast<base_type&>(out);
+         read_json_value(
+            cursor,
+            std::holds_alternative<alt_type>(base) ? std::get<alt_type>(base) : base.template emplace<alt_type>());
+         return;
+      }
+   }
+   throw std::runtime_error{"JSON value doesn't match any variant alternative"};
+}
+
+// Containers and strings already in out are read into where they are, so reading a value into an out that held one
+// of the same shape allocates nothing
+template<typename T>
+constexpr void read_json_value(json_cursor& cursor, T& out)
+{
+   if constexpr (std::same_as<T, bool>) {
+      out = cursor.read_bool();
+   }
+   else if constexpr (std::same_as<T, std::nullptr_t>) {
+      cursor.read_null();
+   }
+   else if constexpr (std::integral<T>) {
+      out = cursor.read_integer<T>();
+   }
+   else if constexpr (std::floating_point<T>) {
+      out = static_cast<T>(cursor.read_double());
+   }
+   else if constexpr (std::same_as<T, std::string>) {
+      cursor.read_string(out);
+   }
+   else if constexpr (is_specialization_of(^^T, ^^std::optional)) {
+      if (cursor.peek() == 'n') {
+         cursor.read_null();
+         out.reset();
+      }
+      else {
+         read_json_value(cursor, out ? *out : out.emplace());
+      }
+   }
+   else if constexpr (is_specialization_of(^^T, ^^std::vector)) {
+      cursor.expect('[');
+      if (cursor.consume(']')) {
+         out.clear();
+         return;
+      }
+      std::size_t size = 0;
+      do {
+         read_json_value(cursor, size < out.size() ? out[size] : out.emplace_back());
+         size += 1;
+      } while (cursor.consume(','));
+      cursor.expect(']');
+      out.erase(out.begin() + static_cast<std::ptrdiff_t>(size), out.end());
+   }
+   else if constexpr (is_string_map<T>()) {
+      auto entries = reused_map_entries{out};
+      cursor.expect('{');
+      if (cursor.consume('}')) {
+         return;
+      }
+      std::string key_scratch;
+      do {
+         read_json_value(cursor, entries[cursor.read_key(key_scratch)]);
+      } while (cursor.consume(','));
+      cursor.expect('}');
+   }
+   else if constexpr (variant_base_of(^^T) != std::meta::info{}) {
+      read_variant(cursor, out);
+   }
+   else if constexpr (std::is_aggregate_v<T>) {
+      read_aggregate(cursor, out);
+   }
+   else {
+      static_assert(false, "type can't be read from JSON");
+   }
+}
+
+// The single value in json, read into out
+template<typename T>
+constexpr void read_json_document(const std::string_view json, T& out)
+{
+   auto cursor = json_cursor{json};
+   read_json_value(cursor, out);
+   if (!cursor.at_end()) {
+      throw std::runtime_error{"unexpected data after end of JSON object"};
+   }
+}
+
+} // namespace impl
+
+// Members missing from the input keep their default values and unknown keys are skipped, unless T has an
+// additional_properties map to collect them in
+template<typename T>
+constexpr T from_json(const std::string_view json)
+{
+   T to_ret{};
+   impl::read_json_document(json, to_ret);
+   return to_ret;
+}
+
+// out ends up as from_json<T>(json) would make it, but strings, vectors, optionals and maps already in out are
+// read into rather than made again, so a message loop that reads every message into the same T stops allocating
+// once it has seen messages of every shape it gets. If json doesn't parse, what's left in out is unspecified.
+template<typename T>
+constexpr void from_json_into(T& out, const std::string_view json)
+{
+   impl::read_json_document(json, out);
+}
+
+namespace impl {
+
+template<typename T>
+consteval std::string joined_member_fragments()
+{
+   std::string to_ret;
+   for (const auto name : member_lookup<T>::names) {
+      if (name != additional_properties_name) {
+         to_ret += ",\"";
+         to_ret += name;
+         to_ret += "\":";
+      }
+   }
+   return to_ret;
+}
+
+// Every member's ,"name": prefix concatenated into one fixed_string at compile time. The leading comma is
+// skipped for the first member written.
+template<typename T>
+struct member_fragments {
+   using lookup = member_lookup<T>;
+
+   static constexpr auto text = fixed_string<joined_member_fragments<T>().size() + 1>{joined_member_fragments<T>()};
+
+   // Start of each member's fragment within text, plus the end of the last one
+   static constexpr auto offsets = []() {
+      std::array<std::size_t, lookup::names.size() + 1> to_ret{};
+      std::size_t offset = 0;
+      for (std::size_t i = 0; i < lookup::names.size(); ++i) {
+         to_ret[i] = offset;
+         if (lookup::names[i] != additional_properties_name) {
+            offset += lookup::names[i].size() + 4;
+         }
+      }
+      to_ret.back() = offset;
+      return to_ret;
+   }();
+
+   static consteval std::string_view fragment(std::size_t i)
+   {
+      return std::string_view{text.storage_, offsets.back()}.substr(offsets[i], offsets[i + 1] - offsets[i]);
+   }
+};
+
+template<typename T>
+constexpr void write_json_value(json_output auto& out, const T& value);
+
+template<typename T>
+constexpr void write_aggregate(json_output auto& out, const T& value)
+{
+   using lookup = member_lookup<T>;
+   using fragments = member_fragments<T>;
+   out.push_back('{');
+   bool first = true;
+   const auto write_member = [&](std::string_view fragment, const auto& member) {
+      out.append(first ? fragment.substr(1) : fragment);
+      first = false;
+      write_json_value(out, member);
+   };
+   template for (constexpr auto i : ::define_static_array(std::views::iota(0zu, lookup::members.size())))
+   {
+      constexpr auto mem = lookup::members[i];
+      constexpr auto fragment = fragments::fragment(i);
+      if constexpr (lookup::names[i] != additional_properties_name) {
+         // Absent optionals are left out rather than written as null
+         if constexpr (is_specialization_of(std::meta::type_of(mem), ^^std::optional)) {
+            if (value.[:mem:]) {
+               write_member(fragment, *value.[:mem:]);
+            }
+         }
+         else {
+            write_member(fragment, value.[:mem:]);
+         }
+      }
+   }
+   if constexpr (lookup::has_additional_properties()) {
+      for (const auto& [key, extra] : value.[:lookup::members[lookup::find(additional_properties_name)]:]) {
+         if (!first) {
+            out.push_back(',');
+         }
+         first = false;
+         write_json_string(out, key);
+         out.push_back(':');
+         write_json_value(out, extra);
+      }
+   }
+   out.push_back('}');
+}
+
+template<typename T>
+constexpr void write_json_value(json_output auto& out, const T& value)
+{
+   if constexpr (std::same_as<T, bool>) {
+      out.append(value ? "true" : "false");
+   }
+   else if constexpr (std::same_as<T, std::nullptr_t>) {
+      out.append("null");
+   }
+   else if constexpr (std::integral<T> || std::floating_point<T>) {
+      write_json_number(out, value);
+   }
+   else if constexpr (std::convertible_to<const T&, std::string_view>) {
+      write_json_string(out, value);
+   }
+   else if constexpr (is_specialization_of(^^T, ^^std::optional)) {
+      if (value) {
+         write_json_value(out, *value);
+      }
+      else {
+         out.append("null");
+      }
+   }
+   else if constexpr (is_specialization_of(^^T, ^^std::vector)) {
+      out.push_back('[');
+      bool first = true;
+      for (const auto& elem : value) {
+         if (!first) {
+            out.push_back(',');
+         }
+         first = false;
+         write_json_value(out, elem);
+      }
+      out.push_back(']');
+   }
+   else if constexpr (is_string_map<T>()) {
+      out.push_back('{');
+      bool first = true;
+      for (const auto& [key, elem] : value) {
+         if (!first) {
+            out.push_back(',');
+         }
+         first = false;
+         write_json_string(out, key);
+         out.push_back(':');
+         write_json_value(out, elem);
+      }
+      out.push_back('}');
+   }
+   else if constexpr (variant_base_of(^^T) != std::meta::info{}) {
+      using base = [:variant_base_of(^^T):];
+      std::visit([&](const auto& alt) { write_json_value(out, alt); }, static_cast<const base&>(value));
+   }
+   else if constexpr (std::is_aggregate_v<T>) {
+      write_aggregate(out, value);
+   }
+   else {
+      static_assert(false, "type can't be written as JSON");
+   }
+}
+
+} // namespace impl
+
+// The only per-member work at run time is copying the precomputed key fragment and formatting the value
+template<typename T>
+constexpr void to_json(const T& value, json_output auto& out)
+{
+   impl::write_json_value(out, value);
+}
+
+#endif // JSON_REFLECT_HPP
@@ -0,0 +1,101 @@
+#ifndef JSON_ROWS_HPP
+#define JSON_ROWS_HPP
+
+#include "json_cursor.hpp"
+#include "json_reflect.hpp"
+
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+
+// The elements of an array read one at a time, all into the same T, so a filter or a sum over them holds one
+// element at a time instead of a vector of all of them. Strings and vectors in T keep their capacity from one
+// element to the next, so once they've grown to fit the elements seen, reading more of them doesn't allocate.
+//
+// This is an input range rather than a std::generator, which libc++ doesn't have yet. The range must stay where
+// it is once begin() has been called, and a reference to the current element is only valid until the next
+// increment.
+template<typename T>
+class json_rows {
+public:
+   class iterator {
+   public:
+      using value_type = T;
+      using difference_type = std::ptrdiff_t;
+
+      constexpr explicit iterator(json_rows* rows) noexcept : rows_{rows} {}
+
+      constexpr const T& operator*() const noexcept { return rows_->row_; }
+      constexpr const T* operator->() const noexcept { return &rows_->row_; }
+
+      constexpr iterator& operator++()
+      {
+         rows_->read_next();
+         return *this;
+      }
+
+      constexpr void operator++(int) { ++*this; }
+
+      friend constexpr bool operator==(const iterator& lhs, std::default_sentinel_t) noexcept
+      {
+         return lhs.at_end();
+      }
+
+   private:
+      constexpr bool at_end() const noexcept { return rows_->done_; }
+
+      json_rows* rows_;
+   };
+
+   // The array is the root of source if key is empty, otherwise the value of key in the root object. Nothing
+   // after the array is looked at.
+   constexpr json_rows(const std::string_view source, const std::string_view key) : cursor_{source}
+   {
+      if (!key.empty()) {
+         cursor_.seek_member(key);
+      }
+      cursor_.expect('[');
+   }
+
+   // Reads the first element, so only call once
+   constexpr iterator begin()
+   {
+      read_next();
+      return iterator{this};
+   }
+
+   constexpr std::default_sentinel_t end() const noexcept { return {}; }
+
+private:
+   // Each element comes out as from_json would read it, with what the previous element allocated reused
+   constexpr void read_next()
+   {
+      if (first_) {
+         first_ = false;
+         if (cursor_.consume(']')) {
+            done_ = true;
+            return;
+         }
+      }
+      else if (!cursor_.consume(',')) {
+         cursor_.expect(']');
+         done_ = true;
+         return;
+      }
+      impl::read_json_value(cursor_, row_);
+   }
+
+   json_cursor cursor_;
+   T row_{};
+   bool first_ = true;
+   bool done_ = false;
+};
+
+// e.g., for (const auto& row : rows<point>(file.view())) to read {"format": ..., "data": [...]} a row at a time
+template<typename T>
+constexpr json_rows<T> rows(const std::string_view source, const std::string_view key = "data")
+{
+   return json_rows<T>{source, key};
+}
+
+#endif // JSON_ROWS_HPP
@@ -0,0 +1,411 @@
+#include "json_cache.hpp"
+#include "json_dom.hpp"
+#include "json_edit.hpp"
+#include "json_file.hpp"
+#include "json_lazy.hpp"
+#include "json_parse.hpp"
+#include "json_path.hpp"
+#include "json_push.hpp"
+#include "json_tape.hpp"
+#include "json_write.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Sums every "id" without building anything, so it runs in constant memory
+struct id_summer {
+   std::int64_t sum = 0;
+   bool next_is_id = false;
+
+   void on_object_begin() { next_is_id = false; }
+   void on_object_end() {}
+   void on_array_begin() { next_is_id = false; }
+   void on_array_end() {}
+   void on_key(std::string_view key) { next_is_id = key == "id"; }
+   void on_string(std::string_view) { next_is_id = false; }
+   void on_double(double) { next_is_id = false; }
+   void on_bool(bool) { next_is_id = false; }
+   void on_null() { next_is_id = false; }
+
+   void on_int64(std::int64_t v)
+   {
+      if (next_is_id) {
+         sum += v;
+      }
+      next_is_id = false;
+   }
+};
+
+struct heartbeat {
+   std::string service;
+   std::int64_t sequence;
+   bool healthy;
+};
+
+// Shortest round trip formatting, so every value should parse back exactly
+std::string make_number_document(const std::vector<double>& values)
+{
+   std::string to_ret = "[";
+   for (std::size_t i = 0; i < values.size(); ++i) {
+      to_ret += std::format("{}{}", i == 0 ? "" : ",", values[i]);
+   }
+   to_ret += "]";
+   return to_ret;
+}
+
+std::string make_document(std::size_t num_items)
+{
+   std::string to_ret = R"({"data": [)";
+   for (std::size_t i = 0; i < num_items; ++i) {
+      if (i != 0) {
+         to_ret += ", ";
+      }
+      to_ret += std::format(R"({{"id": {}, "name": "item \"{}\"", "ok": {}, "tags": [1, 2, 3]}})", i, i, i % 2 == 0);
+   }
+   to_ret += "]}";
+   return to_ret;
+}
+
+int main()
+{
+   // Same document as the static_asserts in json_struct.cpp, but parsed at run time
+   const std::string small = R"({"a": 123, "b": [1, 2, 3], "c": "\"quoted\"", "d": {}, "e": []})";
+   const auto small_json = parse_json(small);
+   const auto& small_map = std::get<json_map>(small_json);
+   assert(get_by_key(small_map, "a") == json_value{123});
+   assert((get_by_key(small_map, "b") == json_value{json_array{1, 2, 3}}));
+   assert(get_by_key(small_map, "c") == json_value{R"(\"quoted\")"});
+   assert(std::get<json_map>(get_by_key(small_map, "d")).empty());
+   assert(std::get<json_array>(get_by_key(small_map, "e")).empty());
+   const json_value built{json_map{{"a", 123}, {"b", json_array{1, true, nullptr}}, {"c", "\"quoted\"\n"}}};
+   assert(to_json_string(built) == R"({"a":123,"b":[1,true,null],"c":"\"quoted\"\n"})");
+   // A file_sink asked for no buffer gets a one-character one rather than none
+   const auto sink_file = std::tmpfile();
+   {
+      file_sink sink{sink_file, 0};
+      write_json(built, sink);
+      sink.append("");
+   }
+   std::rewind(sink_file);
+   std::string sunk(64, '\0');
+   sunk.resize(std::fread(sunk.data(), 1, sunk.size(), sink_file));
+   std::fclose(sink_file);
+   assert(sunk == to_json_string(built));
+   assert((
+      to_json_string(json_value{json_map{{"a", json_array{1}}}}, {.pretty = true})
+      == "{\n   \"a\": [\n      1\n   ]\n}"));
+   // Strings parse_json didn't decode are written back out as they were rather than escaped a second time, also
+   // from a map taken out of the value or a copy of part of it
+   const std::string_view escaped = R"({"a\"b":["c\\d\n",{"\u00e9":"\t"}],"e":"f"})";
+   const auto escaped_json = parse_json(escaped);
+   assert(to_json_string(escaped_json, {.raw_strings = true}) == escaped);
+   std::string escaped_out;
+   write_json(std::get<json_map>(escaped_json), escaped_out, {.raw_strings = true});
+   assert(escaped_out == escaped);
+   const json_value escaped_copy{std::get<json_array>(get_by_key(std::get<json_map>(escaped_json), R"(a\"b)"))};
+   assert(to_json_string(escaped_copy, {.raw_strings = true}) == R"(["c\\d\n",{"\u00e9":"\t"}])");
+   const json_value escaped_string{std::get<std::string_view>(std::get<json_array>(escaped_copy)[0])};
+   assert(to_json_string(escaped_string, {.raw_strings = true}) == R"("c\\d\n")");
+
+   const auto too_deep = std::string(1025, '[') + std::string(1025, ']');
+   try {
+      parse_json(too_deep);
+      assert(false);
+   }
+   catch (const std::runtime_error&) {
+   }
+   assert(std::get<json_array>(parse_json(too_deep, {.max_depth = 1025})).size() == 1);
+
+   for (const std::string_view bad_utf8 : {"\"\xff\"", "[\"\xc3\"]", "\"\xed\xa0\x80\"", "\"\xf0\x9f\x98\""}) {
+      try {
+         parse_json(bad_utf8);
+         assert(false);
+      }
+      catch (const std::runtime_error&) {
+      }
+   }
+   json_string_arena arena;
+   const auto decoded = parse_json(small, arena);
+   assert(get_by_key(std::get<json_map>(decoded), "c") == json_value{"\"quoted\""});
+   // Paths find decoded keys too, and a decoded key that's no longer validly escaped doesn't stop the search
+   const auto decoded_keys = parse_json(R"({"c\\": 1, "a\/b": 2})", arena);
+   assert(get_by_path(decoded_keys, json_path{"/a~1b"}) == json_value{2});
+   assert(get_by_path(decoded_keys, json_path{"/c\\"}) == json_value{1});
+
+   const auto document = make_document(1'000'000);
+   const auto start = std::chrono::steady_clock::now();
+   const auto indexes = find_structural_indexes(document);
+   const auto scanned = std::chrono::steady_clock::now();
+   const auto json = parse_json(document);
+   const auto parsed = std::chrono::steady_clock::now();
+   const auto tape = parse_json_tape(document);
+   const auto taped = std::chrono::steady_clock::now();
+   out_buffer out{document.size()};
+   write_json(json, out);
+   const auto written = std::chrono::steady_clock::now();
+   id_summer summer;
+   parse_json_events(document, summer);
+   const auto summed = std::chrono::steady_clock::now();
+   id_summer push_summer;
+   json_push_parser pusher{push_summer};
+   for (std::size_t i = 0; i < document.size(); i += 1 << 16) {
+      pusher.feed(std::string_view{document}.substr(i, 1 << 16));
+   }
+   pusher.finish();
+   const auto pushed = std::chrono::steady_clock::now();
+   arena.clear();
+   const auto decoded_json = parse_json(document, arena);
+   const auto decoded_parsed = std::chrono::steady_clock::now();
+   const auto lazy = parse_json_lazy(document);
+   const auto lazy_last = get<lazy_array>(get<lazy_map>(lazy.root())["data"])[999'999];
+   const auto lazy_id = get<std::int64_t>(get<lazy_map>(lazy_last)["id"]);
+   const auto looked_up = std::chrono::steady_clock::now();
+
+   // One field out of many small messages, as from a queue, with the path compiled once
+   std::vector<std::string> messages;
+   for (std::size_t i = 0; i < 1'000'000; ++i) {
+      messages.push_back(std::format(
+         R"({{"id": {}, "meta": {{"source": "sensor-{}", "tags": [1, 2]}}, "reading": {{"value": {}, "unit": "C"}}}})",
+         i,
+         i % 16,
+         i % 100));
+   }
+   const json_path reading_path{"reading.value"};
+   const auto messages_start = std::chrono::steady_clock::now();
+   std::size_t found_sum = 0;
+   for (const auto& message : messages) {
+      found_sum += find_by_path(message, reading_path)->size();
+   }
+   const auto messages_found = std::chrono::steady_clock::now();
+   std::size_t parsed_sum = 0;
+   for (const auto& message : messages) {
+      parsed_sum += static_cast<std::size_t>(std::get<std::int64_t>(get_by_path(parse_json(message), reading_path)));
+   }
+   const auto messages_parsed = std::chrono::steady_clock::now();
+
+   // Room for two heartbeats: a hit moves its entry to the front, so a third evicts the other one. A document
+   // bigger than max_bytes is parsed and handed out, but never kept, and max_entries = 0 keeps nothing.
+   const auto make_heartbeat = [](const std::string_view service, std::int64_t sequence) {
+      return std::format(R"({{"service": "{}", "sequence": {}, "healthy": true}})", service, sequence);
+   };
+   json_parse_cache<heartbeat> small_cache{{.max_entries = 2, .max_bytes = 128}};
+   small_cache.get(make_heartbeat("a", 1));
+   small_cache.get(make_heartbeat("b", 2));
+   small_cache.get(make_heartbeat("a", 1));
+   small_cache.get(make_heartbeat("c", 3));
+   assert(small_cache.size() == 2 && small_cache.hits() == 1 && small_cache.misses() == 3);
+   assert(small_cache.get(make_heartbeat("a", 1))->sequence == 1 && small_cache.hits() == 2);
+   assert(small_cache.get(make_heartbeat("b", 2))->sequence == 2 && small_cache.misses() == 4);
+   const auto big_heartbeat = make_heartbeat(std::string(200, 'd'), 4);
+   assert(small_cache.get(big_heartbeat)->sequence == 4 && small_cache.get(big_heartbeat)->sequence == 4);
+   assert(small_cache.size() == 2 && small_cache.hits() == 2 && small_cache.misses() == 6);
+   json_parse_cache<heartbeat> no_cache{{.max_entries = 0}};
+   no_cache.get(make_heartbeat("a", 1));
+   assert(no_cache.get(make_heartbeat("a", 1))->sequence == 1 && no_cache.size() == 0 && no_cache.misses() == 2);
+
+   // Byte-identical heartbeats from 16 services, only the first of each parsed when cached
+   std::vector<std::string> heartbeats;
+   for (std::size_t i = 0; i < 1'000'000; ++i) {
+      heartbeats.push_back(std::format(R"({{"service": "svc-{}", "sequence": {}, "healthy": true}})", i % 16, i % 16));
+   }
+   json_parse_cache<heartbeat> heartbeat_cache;
+   const auto heartbeats_start = std::chrono::steady_clock::now();
+   std::int64_t cached_sum = 0;
+   for (const auto& message : heartbeats) {
+      cached_sum += heartbeat_cache.get(message)->sequence;
+   }
+   const auto heartbeats_cached = std::chrono::steady_clock::now();
+   std::int64_t uncached_sum = 0;
+   for (const auto& message : heartbeats) {
+      uncached_sum += from_json<heartbeat>(message).sequence;
+   }
+   const auto heartbeats_parsed = std::chrono::steady_clock::now();
+   heartbeat reused_heartbeat;
+   std::int64_t reused_sum = 0;
+   for (const auto& message : heartbeats) {
+      from_json_into(reused_heartbeat, message);
+      reused_sum += reused_heartbeat.sequence;
+   }
+   const auto heartbeats_reused = std::chrono::steady_clock::now();
+
+   // A one-value edit near the end, first keeping the length of the text and then growing it
+   json_editable_document editable{document};
+   const auto edit_at = document.rfind(R"("id": 999990)") + 6;
+   const auto edit_start = std::chrono::steady_clock::now();
+   editable.replace(edit_at, 6, "123456");
+   const auto edited_in_place = std::chrono::steady_clock::now();
+   editable.replace(edit_at, 6, R"({"id": [1, 2]})");
+   const auto edited_grown = std::chrono::steady_clock::now();
+
+   // Every item's "name" redacted and a key added in its place, then the whole document written back out
+   const auto dom_start = std::chrono::steady_clock::now();
+   json_dom dom{document};
+   const auto dom_parsed = std::chrono::steady_clock::now();
+   for (const auto item : get<dom_array>(get_by_key(get<dom_map>(dom.root()), "data"))) {
+      auto members = get<dom_map>(item);
+      members.erase("name");
+      members["checked"].set(true);
+   }
+   const auto dom_edited = std::chrono::steady_clock::now();
+   const auto redacted = to_json_string(dom.root());
+
+   const auto path = std::filesystem::temp_directory_path() / "json_runtime.json";
+   std::ofstream{path, std::ios::binary} << document;
+   const auto file_start = std::chrono::steady_clock::now();
+   const json_file file{path.c_str()};
+   const auto file_json = parse_json(file.view());
+   const auto file_parsed = std::chrono::steady_clock::now();
+   assert(file.is_mapped() && file.view() == document);
+   std::filesystem::remove(path);
+
+   // Written from another thread in small pieces, as a producer on the other end of a pipe would
+   int pipe_fds[2];
+   if (::pipe(pipe_fds) != 0) {
+      throw std::runtime_error{"couldn't create a pipe"};
+   }
+   std::jthread writer{[&] {
+      for (std::size_t i = 0; i < document.size();) {
+         const auto count = ::write(pipe_fds[1], document.data() + i, std::min<std::size_t>(document.size() - i, 4096));
+         if (count <= 0) {
+            break;
+         }
+         i += static_cast<std::size_t>(count);
+      }
+      ::close(pipe_fds[1]);
+   }};
+   const auto stream_start = std::chrono::steady_clock::now();
+   id_summer stream_summer;
+   parse_json_stream(pipe_fds[0], stream_summer);
+   const auto streamed = std::chrono::steady_clock::now();
+   writer.join();
+   ::close(pipe_fds[0]);
+
+   // A chunk is handed over as soon as it's read, without waiting for the rest of a buffer or for the writer to
+   // close the pipe
+   if (::pipe(pipe_fds) != 0) {
+      throw std::runtime_error{"couldn't create a pipe"};
+   }
+   std::atomic<bool> received = false;
+   bool received_in_time = false;
+   std::jthread trickler{[&] {
+      received_in_time = ::write(pipe_fds[1], "[1", 2) == 2;
+      const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+      while (!received && std::chrono::steady_clock::now() < deadline) {
+         std::this_thread::yield();
+      }
+      received_in_time = received_in_time && received && ::write(pipe_fds[1], "]", 1) == 1;
+      ::close(pipe_fds[1]);
+   }};
+   std::string trickled;
+   read_pipelined(pipe_fds[0], [&](std::string_view chunk) {
+      trickled += chunk;
+      received = trickled.size() >= 2;
+   });
+   trickler.join();
+   ::close(pipe_fds[0]);
+   assert(received_in_time && trickled == "[1]");
+
+   // An error in the input is thrown even though the pipe's writer stays open, rather than waiting on the next read
+   if (::pipe(pipe_fds) != 0) {
+      throw std::runtime_error{"couldn't create a pipe"};
+   }
+   assert(::write(pipe_fds[1], "]", 1) == 1);
+   try {
+      id_summer bad_stream_summer;
+      parse_json_stream(pipe_fds[0], bad_stream_summer);
+      assert(false);
+   }
+   catch (const std::runtime_error&) {
+   }
+   ::close(pipe_fds[0]);
+   ::close(pipe_fds[1]);
+
+   const auto& data = std::get<json_array>(get_by_key(std::get<json_map>(json), "data"));
+   assert(data.size() == 1'000'000);
+   assert(get_by_key(std::get<json_map>(data.back()), "id") == json_value{999'999});
+   const auto tape_data = get<tape_array>(get_by_key(get<tape_map>(tape.root()), "data"));
+   assert(tape_data.size() == 1'000'000);
+   assert(summer.sum == 999'999LL * 1'000'000 / 2);
+   assert(push_summer.sum == summer.sum);
+   assert(get<std::int64_t>(get_by_key(get<tape_map>(tape_data[999'999]), "id")) == 999'999);
+   assert(lazy_id == 999'999);
+   assert(cached_sum == uncached_sum && cached_sum == 1'000'000 / 16 * 120 && reused_sum == cached_sum);
+   assert(heartbeat_cache.misses() == 16 && heartbeat_cache.hits() == heartbeats.size() - 16);
+   assert(editable.entries() == parse_json_tape(editable.text()).entries());
+   assert(redacted.starts_with(R"({"data":[{"id":0,"ok":true,"tags":[1,2,3],"checked":true},{"id":1,)"));
+   assert(redacted.find("name") == std::string::npos);
+   // 10 one-digit and 90 two-digit values in every 100 messages, and the values themselves sum to 4950
+   assert(found_sum == messages.size() / 100 * 190);
+   assert(parsed_sum == messages.size() / 100 * 4950);
+   assert(std::get<json_array>(get_by_key(std::get<json_map>(file_json), "data")).size() == 1'000'000);
+   assert(stream_summer.sum == summer.sum);
+   const auto& decoded_data = std::get<json_array>(get_by_key(std::get<json_map>(decoded_json), "data"));
+   assert(get_by_key(std::get<json_map>(decoded_data.back()), "name") == json_value{"item \"999999\""});
+
+   std::mt19937_64 rng{42};
+   std::uniform_real_distribution<double> readings{-1000.0, 1000.0};
+   std::vector<double> values(1'000'000);
+   for (auto& value : values) {
+      value = readings(rng);
+   }
+   const auto number_document = make_number_document(values);
+   const auto numbers_start = std::chrono::steady_clock::now();
+   const auto numbers = parse_json(number_document);
+   const auto numbers_parsed = std::chrono::steady_clock::now();
+   const auto& number_array = std::get<json_array>(numbers);
+   for (std::size_t i = 0; i < values.size(); ++i) {
+      assert(std::get<double>(number_array[i]) == values[i]);
+   }
+
+   const auto gb_per_sec = [&](auto from, auto to) {
+      return static_cast<double>(document.size()) / std::chrono::duration<double>(to - from).count() / 1e9;
+   };
+   std::println("document size: {} bytes, {} structural characters", document.size(), indexes.size());
+   std::println("structural scan: {:.2f} GB/s", gb_per_sec(start, scanned));
+   std::println("full parse: {:.2f} GB/s", gb_per_sec(scanned, parsed));
+   std::println("tape parse: {:.2f} GB/s ({} entries)", gb_per_sec(parsed, taped), tape.entries().size());
+   std::println("compact write: {:.2f} GB/s ({} bytes)", gb_per_sec(taped, written), out.size());
+   std::println("event parse: {:.2f} GB/s", gb_per_sec(written, summed));
+   std::println("push parse, 64 KiB chunks: {:.2f} GB/s", gb_per_sec(summed, pushed));
+   std::println("full parse, strings decoded: {:.2f} GB/s", gb_per_sec(pushed, decoded_parsed));
+   std::println("lazy lookup of the last id: {:.2f} GB/s", gb_per_sec(decoded_parsed, looked_up));
+   const auto millions_per_sec = [](std::size_t count, auto from, auto to) {
+      return static_cast<double>(count) / std::chrono::duration<double>(to - from).count() / 1e6;
+   };
+   std::println(
+      "one path from small messages: {:.2f}M messages/s raw, {:.2f}M messages/s parsed first",
+      millions_per_sec(messages.size(), messages_start, messages_found),
+      millions_per_sec(messages.size(), messages_found, messages_parsed));
+   std::println(
+      "repeated heartbeats: {:.2f}M messages/s cached, {:.2f}M messages/s parsed each time, {:.2f}M messages/s into "
+      "one object",
+      millions_per_sec(heartbeats.size(), heartbeats_start, heartbeats_cached),
+      millions_per_sec(heartbeats.size(), heartbeats_cached, heartbeats_parsed),
+      millions_per_sec(heartbeats.size(), heartbeats_parsed, heartbeats_reused));
+   std::println(
+      "incremental reparse: {:.1f} us same length, {:.1f} us grown",
+      std::chrono::duration<double, std::micro>(edited_in_place - edit_start).count(),
+      std::chrono::duration<double, std::micro>(edited_grown - edited_in_place).count());
+   std::println(
+      "mutable DOM: {:.2f} GB/s parsed, {:.1f} ms to redact and add a member to every item",
+      gb_per_sec(dom_start, dom_parsed),
+      std::chrono::duration<double, std::milli>(dom_edited - dom_parsed).count());
+   std::println("mapped file, full parse: {:.2f} GB/s", gb_per_sec(file_start, file_parsed));
+   std::println("pipe, pipelined push parse: {:.2f} GB/s", gb_per_sec(stream_start, streamed));
+   std::println(
+      "double array parse: {:.2f} GB/s ({} values)",
+      static_cast<double>(number_document.size())
+         / std::chrono::duration<double>(numbers_parsed - numbers_start).count() / 1e9,
+      values.size());
+}
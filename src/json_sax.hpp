@@ -0,0 +1,214 @@
+#ifndef JSON_SAX_HPP
+#define JSON_SAX_HPP
+
+#include "json_number.hpp"
+#include "json_simd.hpp"
+#include "json_string.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+// Receives a document as a sequence of events instead of a tree. Strings and keys are passed as they appear in
+// the input, escape sequences included, and are only valid for as long as the input is, unless the parse is given
+// a json_string_arena to decode them into.
+template<typename T>
+concept json_handler = requires(T& handler, std::string_view v, std::int64_t i, double d, bool b) {
+   handler.on_object_begin();
+   handler.on_object_end();
+   handler.on_array_begin();
+   handler.on_array_end();
+   handler.on_key(v);
+   handler.on_string(v);
+   handler.on_int64(i);
+   handler.on_double(d);
+   handler.on_bool(b);
+   handler.on_null();
+};
+
+struct parse_options {
+   // Maximum number of containers open at once; deeper documents are rejected rather than parsed
+   std::size_t max_depth = 1024;
+};
+
+namespace impl {
+
+// true, false, null or a number, without surrounding whitespace. Numbers are only passed as doubles if they have
+// a fraction or exponent, or don't fit in std::int64_t.
+constexpr void emit_scalar(json_handler auto& handler, const std::string_view scalar)
+{
+   if (scalar == "true") {
+      handler.on_bool(true);
+   }
+   else if (scalar == "false") {
+      handler.on_bool(false);
+   }
+   else if (scalar == "null") {
+      handler.on_null();
+   }
+   else {
+      const auto number = try_parse_json_number(scalar.data(), scalar.data() + scalar.size());
+      if (!number || number->ptr != scalar.data() + scalar.size()) {
+         throw std::runtime_error{"unexpected token"};
+      }
+      if (const auto integer = std::get_if<std::int64_t>(&number->value)) {
+         handler.on_int64(*integer);
+      }
+      else {
+         handler.on_double(std::get<double>(number->value));
+      }
+   }
+}
+
+template<json_handler Handler>
+struct event_parser {
+   structural_index_stream& indexes;
+   Handler& handler;
+   std::size_t max_depth;
+   // Where escaped strings are decoded to, or null to pass them on raw
+   json_string_arena* arena;
+   // '{' or '[' for each open container. Nesting is tracked here rather than on the call stack, so depth is
+   // bounded by max_depth instead of by the thread's stack size or the constant evaluation depth limit.
+   std::vector<char> open = {};
+
+   constexpr char peek_char()
+   {
+      const auto pos = indexes.peek();
+      return pos == indexes.json().size() ? '\0' : indexes.json()[pos];
+   }
+
+   constexpr char next_char() { return indexes.json()[indexes.next()]; }
+
+   constexpr std::string_view string_at(std::uint32_t open)
+   {
+      const auto close = indexes.next();
+      const auto raw = indexes.json().substr(open + 1, close - open - 1);
+      // Until the scan meets a backslash, every string is its own text and doesn't need to be searched
+      if (arena == nullptr || !indexes.saw_backslash()) {
+         return raw;
+      }
+      return decode_json_string(raw, *arena);
+   }
+
+   // Scalars aren't followed by a structural character when they're the whole document, hence peek() giving
+   // the input size in that case
+   constexpr void parse_scalar(std::uint32_t start)
+   {
+      auto scalar = indexes.json().substr(start, indexes.peek() - start);
+      while (!scalar.empty() && is_whitespace(scalar.back())) {
+         scalar.remove_suffix(1);
+      }
+      emit_scalar(handler, scalar);
+   }
+
+   constexpr void parse_key()
+   {
+      const auto key_start = indexes.next();
+      if (indexes.json()[key_start] != '"') {
+         throw std::runtime_error{"expected string for JSON key"};
+      }
+      handler.on_key(string_at(key_start));
+      if (next_char() != ':') {
+         throw std::runtime_error{"expected colon after JSON key"};
+      }
+   }
+
+   // Empty containers are never pushed, but still count towards the depth
+   constexpr void check_depth() const
+   {
+      if (open.size() == max_depth) {
+         throw std::runtime_error{"JSON nesting too deep"};
+      }
+   }
+
+   // Each pass of the outer loop starts one value. Opening a non-empty container pushes it and moves straight
+   // on to its first value; once a value is complete, the inner loop closes containers until one continues.
+   constexpr void parse_value()
+   {
+      open.reserve(std::min(max_depth, parse_options{}.max_depth));
+      while (true) {
+         const auto start = indexes.next();
+         switch (indexes.json()[start]) {
+         case '{':
+            check_depth();
+            handler.on_object_begin();
+            if (peek_char() == '}') {
+               indexes.next();
+               handler.on_object_end();
+               break;
+            }
+            open.push_back('{');
+            parse_key();
+            continue;
+         case '[':
+            check_depth();
+            handler.on_array_begin();
+            if (peek_char() == ']') {
+               indexes.next();
+               handler.on_array_end();
+               break;
+            }
+            open.push_back('[');
+            continue;
+         case '"': handler.on_string(string_at(start)); break;
+         default: parse_scalar(start); break;
+         }
+         while (true) {
+            if (open.empty()) {
+               return;
+            }
+            const auto sep = next_char();
+            if (sep == ',') {
+               if (open.back() == '{') {
+                  parse_key();
+               }
+               break;
+            }
+            if (open.back() == '{') {
+               if (sep != '}') {
+                  throw std::runtime_error{"unexpected token after dict value"};
+               }
+               handler.on_object_end();
+            }
+            else {
+               if (sep != ']') {
+                  throw std::runtime_error{"unexpected token after array value"};
+               }
+               handler.on_array_end();
+            }
+            open.pop_back();
+         }
+      }
+   }
+};
+
+} // namespace impl
+
+// Drives handler through the single value in json. Only a window of structural positions is kept (see
+// structural_index_stream), so a handler that doesn't hold on to what it's given runs in constant memory.
+constexpr void parse_json_events(const std::string_view json, json_handler auto& handler, parse_options options = {})
+{
+   auto indexes = structural_index_stream{json};
+   auto parser = impl::event_parser{indexes, handler, options.max_depth, nullptr};
+   parser.parse_value();
+   if (!indexes.at_end()) {
+      throw std::runtime_error{"unexpected data after end of JSON object"};
+   }
+}
+
+// As above, but strings and keys with escape sequences are decoded into arena, so the handler is given their text.
+// Strings without escapes are still views of json.
+constexpr void parse_json_events(
+   const std::string_view json, json_handler auto& handler, json_string_arena& arena, parse_options options = {})
+{
+   auto indexes = structural_index_stream{json};
+   auto parser = impl::event_parser{indexes, handler, options.max_depth, &arena};
+   parser.parse_value();
+   if (!indexes.at_end()) {
+      throw std::runtime_error{"unexpected data after end of JSON object"};
+   }
+}
+
+#endif // JSON_SAX_HPP
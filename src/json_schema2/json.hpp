@@ -1,17 +1,21 @@
 #ifndef KHCT_JSON_HPP
 #define KHCT_JSON_HPP
 
+#include "../json_number.hpp"
 #include "common.hpp"
 #include "map.hpp"
 #include "string.hpp"
 
 #include <algorithm>
-#include <cassert>
+#include <array>
 #include <compare>
 #include <cstdint>
 #include <limits>
 #include <optional>
+#include <ranges>
 #include <string_view>
+#include <utility>
+#include <variant>
 
 namespace khct {
 
@@ -86,16 +90,60 @@ inline constexpr auto is_num = [](char c) { return c >= '0' && c <= '9'; };
 inline constexpr auto is_nonzero_num = [](char c) { return c >= '1' && c <= '9'; };
 inline constexpr auto lex_comp = [](auto a, auto b) { return std::ranges::lexicographical_compare(a, b); };
 
+// The document is tokenized in one go over a string_view into a flat array of nodes, and only then turned into
+// types. Tokenizing one template instantiation at a time, with the rest of the input as a new string each step,
+// made compile time and memory grow with the square of the document's size.
+
+enum class flat_kind : std::uint8_t {
+   object,
+   array,
+   string,
+   int64,
+   uint64,
+   double_value,
+   true_value,
+   false_value,
+   null_value,
+};
+
+enum class flat_error : std::uint8_t {
+   none,
+   number_too_large,
+   remaining_input,
+   unexpected_input,
+   invalid_double,
+   invalid_string,
+   unexpected_end_of_input,
+};
+
+// A value is followed by its children, so its subtree ends at end. An object's children are its keys and values in
+// turn.
+struct flat_node {
+   flat_kind kind;
+   std::size_t end;
+   // Strings: position and length in the input, escape sequences included. Containers: number of values or members.
+   std::size_t begin;
+   std::size_t size;
+   std::int64_t int_value;
+   std::uint64_t uint_value;
+   double double_value;
+};
+
+template<std::size_t Size>
+struct flat_json {
+   std::array<flat_node, Size> nodes;
+   flat_error error;
+};
+
 // Pre: Leading whitespace is stripped
-template<string Str>
-consteval std::optional<std::uint64_t> to_unsigned_num(std::uint64_t max_value) noexcept
+consteval std::optional<std::uint64_t> to_unsigned_num(std::string_view str, std::uint64_t max_value) noexcept
 {
-   if (!is_num(Str[0])) {
+   if (str.empty() || !is_num(str[0])) {
       return std::nullopt;
    }
    std::uint64_t to_ret = 0;
-   for (auto iter = std::begin(Str); iter != std::end(Str) && is_num(*iter); ++iter) {
-      const auto next_value = to_ret * 10 + *iter - '0';
+   for (auto iter = str.begin(); iter != str.end() && is_num(*iter); ++iter) {
+      const auto next_value = to_ret * 10 + static_cast<std::uint64_t>(*iter - '0');
       if (next_value > max_value || next_value < to_ret) {
          return std::nullopt;
       }
@@ -104,261 +152,343 @@ consteval std::optional<std::uint64_t> to_unsigned_num(std::uint64_t max_value)
    return to_ret;
 }
 
-template<string Str>
-consteval std::optional<std::int64_t> to_signed_num() noexcept
+consteval std::optional<std::int64_t> to_signed_num(std::string_view str) noexcept
 {
-   constexpr auto has_minus = Str[0] == '-';
-   constexpr auto no_minus = Str | splice<has_minus, Str.size()>;
-   constexpr auto val = to_unsigned_num<no_minus>(std::numeric_limits<std::int64_t>::lowest());
-   if constexpr (val) {
-      constexpr auto ret_val = static_cast<std::int64_t>(*val);
-      return has_minus ? -ret_val : ret_val;
-   }
-   else {
+   const auto has_minus = str.starts_with('-');
+   const auto max_value = static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()) + has_minus;
+   const auto val = to_unsigned_num(str.substr(has_minus), max_value);
+   if (!val) {
       return std::nullopt;
    }
+   if (*val == max_value && has_minus) {
+      return std::numeric_limits<std::int64_t>::lowest();
+   }
+   return has_minus ? -static_cast<std::int64_t>(*val) : static_cast<std::int64_t>(*val);
 }
 
-template<string Str>
-consteval std::optional<double> to_double() noexcept
-{
-   constexpr auto e_loc = std::ranges::find_if(Str, [](char c) { return c == 'e' || c == 'E'; });
-   if constexpr (Str[0] == '-') {
-      constexpr auto val = to_double<Str | splice<1, Str.size()>>();
-      if constexpr (val) {
-         return -*val;
+// Writes the nodes to out if it isn't null, otherwise only counts them
+class json_flattener {
+public:
+   consteval json_flattener(std::string_view input, flat_node* out) noexcept : input_{input}, out_{out} {}
+
+   consteval flat_error run() noexcept
+   {
+      skip_whitespace();
+      if (!value()) {
+         return error_;
       }
-      else {
-         return std::nullopt;
+      skip_whitespace();
+      return pos_ == input_.size() ? flat_error::none : flat_error::remaining_input;
+   }
+
+   consteval std::size_t count() const noexcept { return count_; }
+
+private:
+   consteval char peek() const noexcept { return pos_ < input_.size() ? input_[pos_] : '\0'; }
+
+   consteval void skip_whitespace() noexcept
+   {
+      constexpr auto is_ws
+         = [](char c) { return c == ' ' || c == '\f' || c == '\n' || c == '\r' || c == '\t' || c == '\v'; };
+      while (pos_ < input_.size() && is_ws(input_[pos_])) {
+         ++pos_;
       }
    }
-   else if constexpr (e_loc == std::end(Str)) {
-      double to_ret = 0;
-      auto iter = std::begin(Str);
-      for (; iter != std::end(Str) && is_num(*iter); ++iter) {
-         to_ret = to_ret * 10 + *iter - '0';
+
+   consteval bool fail(flat_error error) noexcept
+   {
+      error_ = error;
+      return false;
+   }
+
+   // The index of a new node of kind, to be filled in once its value has been read
+   consteval std::size_t add(flat_kind kind) noexcept
+   {
+      if (out_ != nullptr) {
+         out_[count_] = flat_node{.kind = kind};
       }
-      assert(*iter == '.');
-      ++iter;
-      double mult = 0.1;
-      for (; iter != std::end(Str) && is_num(*iter); ++iter) {
-         to_ret += mult * (*iter - '0');
-         mult /= 10;
+      return count_++;
+   }
+
+   consteval void finish(std::size_t index, std::size_t begin = 0, std::size_t size = 0) noexcept
+   {
+      if (out_ != nullptr) {
+         out_[index].end = count_;
+         out_[index].begin = begin;
+         out_[index].size = size;
       }
-      return to_ret;
    }
-   else {
-      constexpr auto e_index = std::distance(std::begin(Str), e_loc);
-      constexpr auto left_side = to_signed_num<Str | splice<0, e_index>>();
-      constexpr auto right_side_str = Str | splice<e_index + 1, Str.size()>;
-      constexpr auto starts_plus = right_side_str[0] == '+';
-      constexpr auto right_side = to_signed_num<right_side_str | splice<starts_plus, right_side_str.size()>>();
-      if constexpr (!left_side || !right_side) {
-         return std::nullopt;
+
+   // Pre: Leading whitespace is stripped
+   consteval bool value() noexcept
+   {
+      const auto c = peek();
+      if (c == '{') {
+         return object();
       }
-      else if constexpr (*right_side >= 0) {
-         double mult = 1;
-         for (double i = 0; i < *right_side; i += 1) {
-            mult *= 10;
-         }
-         return *left_side * mult;
+      if (c == '[') {
+         return array();
       }
-      else {
-         double mult = 1;
-         for (double i = 0; i < -*right_side; i += 1) {
-            mult *= .1;
+      if (c == '"') {
+         return string_value();
+      }
+      if (is_nonzero_num(c) || c == '-') {
+         return number();
+      }
+      for (const auto [literal, kind] : {
+              std::pair{std::string_view{"true"}, flat_kind::true_value},
+              std::pair{std::string_view{"false"}, flat_kind::false_value},
+              std::pair{std::string_view{"null"}, flat_kind::null_value}}) {
+         if (input_.substr(pos_).starts_with(literal)) {
+            pos_ += literal.size();
+            finish(add(kind));
+            return true;
          }
-         return *left_side * mult;
       }
+      return fail(flat_error::unexpected_input);
    }
-}
-
-template<string Str>
-consteval auto parse_json_value() noexcept;
 
-template<string ToParse>
-consteval auto parse_array_value() noexcept
-{
-   constexpr auto first_value_and_rest = parse_json_value<ToParse>();
-   // First value has been parsed; check for a comma and quit parsing if there isn't one
-   constexpr auto first_value = first_value_and_rest.first;
-   constexpr auto rest = strip_leading_whitespace<first_value_and_rest.second>();
-   if constexpr (rest[0] == ']') {
-      return pair{tuple{first_value}, rest | splice<1, rest.size()>};
-   }
-   else if constexpr (rest[0] == ',') {
-      constexpr auto parse_next = strip_leading_whitespace<rest | splice<1, rest.size()>>();
-      constexpr auto value_and_rest = parse_array_value<parse_next>();
-      if constexpr (is_json_error(value_and_rest.first)) {
-         return value_and_rest;
+   // A quote escaped by a backslash doesn't end the string
+   consteval bool string_value() noexcept
+   {
+      if (peek() != '"') {
+         return fail(flat_error::invalid_string);
       }
-      else {
-         return pair{tuple_cat(tuple{first_value}, value_and_rest.first), value_and_rest.second};
+      auto end = pos_;
+      do {
+         end = input_.find('"', end + 1);
+      } while (end != std::string_view::npos && input_[end - 1] == '\\');
+      if (end == std::string_view::npos) {
+         return fail(flat_error::invalid_string);
       }
+      finish(add(flat_kind::string), pos_ + 1, end - pos_ - 1);
+      pos_ = end + 1;
+      return true;
    }
-   else {
-      return pair{json_error::unexpected_input, string{""}};
-   }
-}
 
-template<string Str>
-consteval auto parse_json_string() noexcept
-{
-   if constexpr (Str[0] != '"') {
-      return pair{json_error::invalid_string, string{""}};
-   }
-   else {
-      constexpr auto str_end = []() {
-         auto loc = Str.begin();
-         while (true) {
-            ++loc;
-            while (loc != Str.end() && *loc != '\"') {
-               ++loc;
-            }
-            // The below doesn't work for some reason...?
-            // loc = std::find(loc + 1, Str.end(), '"');
-            if (loc == Str.end() || *(loc - 1) != '\\') {
-               return loc;
-            }
+   consteval bool number() noexcept
+   {
+      const auto rest = input_.substr(pos_);
+      const auto number_end = std::ranges::find_if_not(
+         rest, [](char c) { return c == '-' || c == '.' || c == 'e' || c == 'E' || c == '+' || is_num(c); });
+      const auto text = std::string_view{rest.begin(), number_end};
+      const auto index = count_;
+      if (text.find_first_of(".eE") != std::string_view::npos) {
+         const auto number = try_parse_json_number(rest.data(), rest.data() + rest.size());
+         if (!number) {
+            return fail(flat_error::invalid_double);
+         }
+         add(flat_kind::double_value);
+         if (out_ != nullptr) {
+            out_[index].double_value = std::visit([](auto v) { return static_cast<double>(v); }, number->value);
+         }
+      }
+      else if (text[0] == '-') {
+         const auto val = to_signed_num(rest);
+         if (!val) {
+            return fail(flat_error::number_too_large);
+         }
+         add(flat_kind::int64);
+         if (out_ != nullptr) {
+            out_[index].int_value = *val;
          }
-      }();
-      if constexpr (str_end == Str.end()) {
-         return pair{json_error::invalid_string, string{""}};
       }
       else {
-         constexpr auto end_index = std::distance(Str.begin(), str_end);
-         return pair{Str | splice<1, end_index>, Str | splice<end_index + 1, Str.size()>};
+         const auto val = to_unsigned_num(rest, std::numeric_limits<std::uint64_t>::max());
+         if (!val) {
+            return fail(flat_error::number_too_large);
+         }
+         add(flat_kind::uint64);
+         if (out_ != nullptr) {
+            out_[index].uint_value = *val;
+         }
       }
+      finish(index);
+      pos_ += text.size();
+      return true;
    }
-}
 
-template<string Str>
-consteval auto parse_object_value() noexcept
-{
-   constexpr auto name_and_rest = parse_json_string<Str>();
-   if constexpr (is_json_error(name_and_rest)) {
-      return name_and_rest;
-   }
-   else {
-      constexpr auto colon_start = strip_leading_whitespace<name_and_rest.second>();
-      if constexpr (colon_start[0] != ':') {
-         return pair{json_error::unexpected_input, string{""}};
+   consteval bool array() noexcept
+   {
+      const auto index = add(flat_kind::array);
+      ++pos_;
+      skip_whitespace();
+      std::size_t size = 0;
+      if (peek() == ']') {
+         ++pos_;
+         finish(index);
+         return true;
       }
-      else {
-         constexpr auto value_start = strip_leading_whitespace<colon_start | splice<1, colon_start.size()>>();
-         constexpr auto value_and_next = parse_json_value<value_start>();
-         if constexpr (is_json_error(value_and_next)) {
-            return value_and_next;
+      while (true) {
+         if (!value()) {
+            return false;
+         }
+         ++size;
+         skip_whitespace();
+         const auto c = peek();
+         ++pos_;
+         if (c == ']') {
+            finish(index, 0, size);
+            return true;
          }
-         else {
-            constexpr auto indicator_start = strip_leading_whitespace<value_and_next.second>();
-            constexpr auto ret_val = tuple{pair{name_and_rest.first, value_and_next.first}};
-            if constexpr (indicator_start.size() == 0) {
-               return pair{json_error::unexpected_end_of_input, string{""}};
-            }
-            else {
-               constexpr auto next_str
-                  = strip_leading_whitespace<indicator_start | splice<1, indicator_start.size()>>();
-               if constexpr (indicator_start[0] == '}') {
-                  return pair{ret_val, next_str};
-               }
-               else if constexpr (indicator_start[0] == ',') {
-                  constexpr auto next_val = parse_object_value<next_str>();
-                  return pair{tuple_cat(ret_val, next_val.first), next_val.second};
-               }
-               else {
-                  return pair{json_error::unexpected_input, string{""}};
-               }
-            }
+         if (c != ',') {
+            return fail(flat_error::unexpected_input);
          }
+         skip_whitespace();
       }
    }
-}
 
-// Pre: Leading whitespace is stripped
-template<string Str>
-consteval auto parse_json_value() noexcept
-{
-   if constexpr (Str[0] == '{') {
-      constexpr auto next = strip_leading_whitespace<Str | splice<1, Str.size()>>();
-      if constexpr (next[0] == '}') {
-         // Create an empty multi_type_map in this case
-         return pair{multi_type_map<string<1>, decltype(lex_comp), 0, {}, {}>{}, next | splice<1, next.size()>};
+   consteval bool object() noexcept
+   {
+      const auto index = add(flat_kind::object);
+      ++pos_;
+      skip_whitespace();
+      std::size_t size = 0;
+      if (peek() == '}') {
+         ++pos_;
+         finish(index);
+         return true;
       }
-      else {
-         constexpr auto tuple_val = parse_object_value<next>();
-         if constexpr (is_json_error(tuple_val.first)) {
-            return tuple_val;
+      while (true) {
+         if (!string_value()) {
+            return false;
+         }
+         skip_whitespace();
+         if (peek() != ':') {
+            return fail(flat_error::unexpected_input);
+         }
+         ++pos_;
+         skip_whitespace();
+         if (!value()) {
+            return false;
          }
-         else {
-            constexpr auto map = [&]<std::size_t... Is>(std::index_sequence<Is...>) {
-               return make_multi_type_map<get<Is>(tuple_val.first)...>(lex_comp);
-            }(std::make_index_sequence<tuple_val.first.size>{});
-            return pair{map, tuple_val.second};
+         ++size;
+         skip_whitespace();
+         if (pos_ == input_.size()) {
+            return fail(flat_error::unexpected_end_of_input);
          }
+         const auto c = input_[pos_++];
+         if (c == '}') {
+            finish(index, 0, size);
+            return true;
+         }
+         if (c != ',') {
+            return fail(flat_error::unexpected_input);
+         }
+         skip_whitespace();
       }
    }
-   else if constexpr (Str[0] == '[') {
-      constexpr auto next = strip_leading_whitespace<Str | splice<1, Str.size()>>();
-      if constexpr (next[0] == ']') {
-         return pair{tuple{}, next | splice<1, next.size()>};
-      }
-      else {
-         return parse_array_value<next>();
-      }
+
+   std::string_view input_;
+   flat_node* out_;
+   std::size_t pos_ = 0;
+   std::size_t count_ = 0;
+   flat_error error_ = flat_error::none;
+};
+
+template<string Str>
+struct flattened_json {
+   static constexpr auto source = Str;
+
+   static constexpr auto value = []() consteval {
+      constexpr auto size = []() consteval {
+         json_flattener counter{source.view(), nullptr};
+         counter.run();
+         return counter.count();
+      }();
+      flat_json<size> to_ret{};
+      json_flattener flattener{source.view(), to_ret.nodes.data()};
+      to_ret.error = flattener.run();
+      return to_ret;
+   }();
+};
+
+// The indexes of the children of the container at Index
+template<typename Flat, std::size_t Index>
+consteval auto child_indexes() noexcept
+{
+   constexpr auto& node = Flat::value.nodes[Index];
+   std::array<std::size_t, node.kind == flat_kind::object ? node.size * 2 : node.size> to_ret{};
+   auto child = Index + 1;
+   for (auto& index : to_ret) {
+      index = child;
+      child = Flat::value.nodes[child].end;
    }
-   else if constexpr (is_nonzero_num(Str[0]) || Str[0] == '-') {
-      // Look ahead for a period or e to determine if it's a float
-      constexpr auto end_number_loc = std::ranges::find_if_not(
-         Str, [](char c) { return c == '-' || c == '.' || c == 'e' || c == 'E' || c == '+' || is_num(c); });
-      constexpr auto num_str = Str | splice<0, std::distance(std::begin(Str), end_number_loc)>;
-      constexpr auto ret_str = Str | splice<std::distance(std::begin(Str), end_number_loc), Str.size()>;
-      constexpr auto has_period_or_e
-         = std::ranges::find_if(num_str, [](char c) { return c == '.' || c == 'e' || c == 'E'; }) != std::end(num_str);
-      if constexpr (has_period_or_e) {
-         constexpr auto val = to_double<Str>();
-         if constexpr (val) {
-            return pair{*val, ret_str};
-         }
-         else {
-            return pair{json_error::invalid_double, string{""}};
-         }
+   return to_ret;
+}
+
+template<typename Flat, std::size_t Index>
+inline constexpr auto children_of = child_indexes<Flat, Index>();
+
+// Only Flat, a type, is passed along rather than the input, so each node costs one cheap instantiation
+template<typename Flat, std::size_t Index>
+consteval auto reify_json() noexcept
+{
+   constexpr auto& node = Flat::value.nodes[Index];
+   if constexpr (node.kind == flat_kind::object) {
+      if constexpr (node.size == 0) {
+         // Create an empty multi_type_map in this case
+         return multi_type_map<string<1>, decltype(lex_comp), 0, {}, {}>{};
       }
       else {
-         if constexpr (Str[0] == '-') {
-            constexpr auto val = to_signed_num<Str>();
-            if constexpr (val) {
-               return pair{*val, ret_str};
-            }
-            else {
-               return pair{json_error::number_too_large, string{""}};
-            }
-         }
-         else {
-            constexpr auto val = to_unsigned_num<Str>(std::numeric_limits<std::uint64_t>::max());
-            if constexpr (val) {
-               return pair{*val, ret_str};
-            }
-            else {
-               return pair{json_error::number_too_large, string{""}};
-            }
-         }
+         return []<std::size_t... Is>(std::index_sequence<Is...>) {
+            constexpr auto& children = children_of<Flat, Index>;
+            return make_multi_type_map<pair{
+               reify_json<Flat, children[Is * 2]>(), reify_json<Flat, children[Is * 2 + 1]>()}...>(lex_comp);
+         }(std::make_index_sequence<node.size>{});
       }
    }
-   else if constexpr (std::string_view(Str.value_).starts_with("true")) {
-      return pair{true_, Str | splice<4, Str.size()>};
+   else if constexpr (node.kind == flat_kind::array) {
+      return []<std::size_t... Is>(std::index_sequence<Is...>) {
+         constexpr auto& children = children_of<Flat, Index>;
+         return tuple<decltype(reify_json<Flat, children[Is]>())...>{reify_json<Flat, children[Is]>()...};
+      }(std::make_index_sequence<node.size>{});
+   }
+   else if constexpr (node.kind == flat_kind::string) {
+      string<node.size + 1> to_ret{};
+      std::ranges::copy_n(Flat::source.begin() + node.begin, node.size, to_ret.begin());
+      return to_ret;
+   }
+   else if constexpr (node.kind == flat_kind::int64) {
+      return node.int_value;
    }
-   else if constexpr (std::string_view(Str.value_).starts_with("false")) {
-      return pair{false_, Str | splice<5, Str.size()>};
+   else if constexpr (node.kind == flat_kind::uint64) {
+      return node.uint_value;
    }
-   else if constexpr (std::string_view(Str.value_).starts_with("null")) {
-      return pair{null, Str | splice<4, Str.size()>};
+   else if constexpr (node.kind == flat_kind::double_value) {
+      return node.double_value;
    }
-   else if constexpr (Str[0] == '"') {
-      return parse_json_string<Str>();
+   else if constexpr (node.kind == flat_kind::true_value) {
+      return true_;
+   }
+   else if constexpr (node.kind == flat_kind::false_value) {
+      return false_;
    }
    else {
-      return pair{json_error::unexpected_input, string{""}};
+      return null;
+   }
+}
+
+template<flat_error Error>
+consteval auto json_error_value() noexcept
+{
+   if constexpr (Error == flat_error::number_too_large) {
+      return json_error::number_too_large;
+   }
+   else if constexpr (Error == flat_error::remaining_input) {
+      return json_error::remaining_input;
+   }
+   else if constexpr (Error == flat_error::unexpected_input) {
+      return json_error::unexpected_input;
+   }
+   else if constexpr (Error == flat_error::invalid_double) {
+      return json_error::invalid_double;
+   }
+   else if constexpr (Error == flat_error::invalid_string) {
+      return json_error::invalid_string;
+   }
+   else {
+      return json_error::unexpected_end_of_input;
    }
 }
 
@@ -367,13 +497,12 @@ consteval auto parse_json_value() noexcept
 template<string Str>
 consteval auto parse_json() noexcept
 {
-   constexpr auto ret_val_and_rest = detail::parse_json_value<strip_leading_whitespace<Str>()>();
-   constexpr auto rest = ret_val_and_rest.second;
-   if constexpr (strip_leading_whitespace<rest>().empty()) {
-      return ret_val_and_rest.first;
+   using flat = detail::flattened_json<Str>;
+   if constexpr (flat::value.error == detail::flat_error::none) {
+      return detail::reify_json<flat, 0>();
    }
    else {
-      return json_error::remaining_input;
+      return detail::json_error_value<flat::value.error>();
    }
 }
 
@@ -1,5 +1,8 @@
 #include "common.hpp"
 #include "json_parse.hpp"
+#include "json_path.hpp"
+#include "json_reflect.hpp"
+#include "json_tape.hpp"
 
 #include <array>
 #include <cassert>
@@ -13,57 +16,13 @@ constexpr auto type_mapping = std::to_array<std::pair<std::string_view, std::met
     {"integer", ^^tdef<std::int64_t>::type},
     {"string", ^^tdef<std::string>::type}});
 
-constexpr char basic_nested_schema[]{R"(
-{
-   "$schema": "https://json-schema.org/draft/2020-12/schema",
-   "type": "object",
-   "properties": {
-      "pain": {
-         "type": "object",
-         "properties": {
-            "sadness": {
-               "type": "number"
-            }
-         },
-         "required": ["sadness"],
-         "additionalProperties": false
-      }
-   },
-   "required": ["pain"],
-   "additionalProperties": false
-})"};
+constexpr char basic_nested_schema[]{
+#embed "data/basic_nested_schema.json" suffix(, '\0')
+};
 
-constexpr char basic_array_schema[](R"(
-{
-   "$schema": "https://json-schema.org/draft/2020-12/schema",
-   "type": "object",
-   "properties": {
-      "fruits": {
-         "type": "array",
-         "items": {
-            "type": "string"
-         }
-      },
-      "vegetables": {
-         "type": "array",
-         "items": { "$ref": "#/$defs/veggie" }
-      }
-   },
-   "$defs": {
-      "veggie": {
-         "type": "object",
-         "required": [ "veggieName", "veggieLike" ],
-         "properties": {
-            "veggieName": {
-               "type": "string"
-            },
-            "veggieLike": {
-               "type": "boolean"
-            }
-         }
-      }
-   }
-})");
+constexpr char basic_array_schema[]{
+#embed "data/basic_array_schema.json" suffix(, '\0')
+};
 
 struct additional_value
    : std::variant<
@@ -90,24 +49,26 @@ public:
 
 using additional_properties = std::unordered_map<std::string, additional_value>;
 
-consteval std::meta::info handle_object(std::meta::info defs_struct, std::string_view struct_name, json_map def);
-consteval std::meta::info handle_field(std::meta::info defs_struct, std::string_view struct_name, json_map def);
-consteval std::meta::info handle_array(std::meta::info defs_struct, std::string_view struct_name, json_map def);
+// The schema is read straight from a tape in static storage, so each literal is parsed once no matter how many
+// definitions are made from it, and walking it hands out views instead of copying sub-objects
+consteval std::meta::info handle_object(std::meta::info defs_struct, std::string_view struct_name, tape_map def);
+consteval std::meta::info handle_field(std::meta::info defs_struct, std::string_view struct_name, tape_map def);
+consteval std::meta::info handle_array(std::meta::info defs_struct, std::string_view struct_name, tape_map def);
 
-consteval std::meta::info handle_object(std::meta::info defs_struct, std::string_view struct_name, json_map def)
+consteval std::meta::info handle_object(std::meta::info defs_struct, std::string_view struct_name, tape_map def)
 {
    std::vector<std::meta::info> fields;
-   const auto required_fields = [&]() -> std::vector<std::string> {
+   const auto required_fields = [&]() -> std::vector<std::string_view> {
       if (const auto req_ptr = get_by_key_opt(def, "required")) {
-         return std::get<json_array>(*req_ptr)
-              | std::views::transform([](const auto& s) { return std::string(std::get<std::string_view>(s)); })
+         return get<tape_array>(*req_ptr)
+              | std::views::transform([](const auto& s) { return get<std::string_view>(s); })
               | std::ranges::to<std::vector>();
       }
       return {};
    }();
-   for (const auto& [name, props_raw] : std::get<json_map>(get_by_key(def, "properties"))) {
-      const auto& props = std::get<json_map>(props_raw);
-      const auto type = std::get<std::string_view>(get_by_key(props, "type"));
+   for (const auto& [name, props_raw] : get<tape_map>(get_by_key(def, "properties"))) {
+      const auto props = get<tape_map>(props_raw);
+      const auto type = get<std::string_view>(get_by_key(props, "type"));
       // This wasn't compiling when within the lambda...?
       const auto scoped_name = struct_name + std::string("::") + name;
       const std::meta::info type_info = [&]() {
@@ -130,7 +91,7 @@ consteval std::meta::info handle_object(std::meta::info defs_struct, std::string
       }
    }
    const auto add_prop = get_by_key_opt(def, "additionalProperties");
-   if (!add_prop || std::get<bool>(*add_prop)) {
+   if (!add_prop || get<bool>(*add_prop)) {
       fields.push_back(std::meta::data_member_spec(^^additional_properties, {.name = "additional_properties"}));
    }
    const auto static_name = reflect_constant_string(struct_name);
@@ -138,17 +99,17 @@ consteval std::meta::info handle_object(std::meta::info defs_struct, std::string
    return std::meta::define_aggregate(to_define, fields);
 }
 
-consteval std::meta::info handle_field(std::meta::info defs_struct, std::string_view struct_name, json_map def)
+consteval std::meta::info handle_field(std::meta::info defs_struct, std::string_view struct_name, tape_map def)
 {
-   const auto type = std::get<std::string_view>(get_by_key(def, "type"));
+   const auto type = get<std::string_view>(get_by_key(def, "type"));
    const auto iter = std::ranges::find(type_mapping, type, [](const auto& t) { return t.first; });
    assert(iter != type_mapping.end());
    return iter->second;
 }
 
-consteval std::meta::info handle_array(std::meta::info defs_struct, std::string_view struct_name, json_map def)
+consteval std::meta::info handle_array(std::meta::info defs_struct, std::string_view struct_name, tape_map def)
 {
-   const auto items = std::get<json_map>(get_by_key(def, "items"));
+   const auto items = get<tape_map>(get_by_key(def, "items"));
    // See if it's just a simple type first
    if (const auto type = get_by_key_opt(items, "type")) {
       const auto to_add = handle_field(defs_struct, struct_name, items);
@@ -157,27 +118,24 @@ consteval std::meta::info handle_array(std::meta::info defs_struct, std::string_
    }
    else {
       // Should be a def type
-      const auto ref = std::get<std::string_view>(get_by_key(items, "$ref"));
-      constexpr std::string_view def_start = "#/$defs/";
-      assert(ref.starts_with(def_start));
-      const auto name = ref.substr(def_start.size());
+      const auto ref = json_path{get<std::string_view>(get_by_key(items, "$ref"))};
+      assert(ref.size() == 2 && ref.key(0) == "$defs");
+      const auto name = ref.key(1);
       const auto value_type = std::meta::substitute(defs_struct, {reflect_constant_string(name)});
       return std::meta::substitute(^^std::vector, {value_type});
    }
 }
 
-consteval void
-   define_schema_types(std::meta::info defs_struct, std::string_view struct_name, std::string_view json_schema)
+template<fixed_string JsonSchema>
+consteval void define_schema_types(std::meta::info defs_struct, std::string_view struct_name)
 {
-   const auto json = std::get<json_map>(parse_json(json_schema));
+   const auto json = get<tape_map>(parse_json_once<JsonSchema>());
    if (const auto defs_raw = get_by_key_opt(json, "$defs")) {
-      const auto& defs = std::get<json_map>(*defs_raw);
-      for (const auto& [name, info_raw] : defs) {
-         const auto& info = std::get<json_map>(info_raw);
-         handle_object(defs_struct, name, info);
+      for (const auto& [name, info_raw] : get<tape_map>(*defs_raw)) {
+         handle_object(defs_struct, name, get<tape_map>(info_raw));
       }
    }
-   const auto type = std::get<std::string_view>(get_by_key(json, "type"));
+   const auto type = get<std::string_view>(get_by_key(json, "type"));
    handle_object(defs_struct, struct_name, json);
 }
 
@@ -189,8 +147,8 @@ struct v_and_f_structs;
 
 consteval
 {
-   define_schema_types(^^my_defs, "root", basic_nested_schema);
-   define_schema_types(^^v_and_f_structs, "veggies_and_fruits", basic_array_schema);
+   define_schema_types<basic_nested_schema>(^^my_defs, "root");
+   define_schema_types<basic_array_schema>(^^v_and_f_structs, "veggies_and_fruits");
 }
 
 using root = my_defs<"root">;
@@ -204,4 +162,22 @@ const auto heck2 = veggies_and_fruits{
    .vegetables
    = std::vector<veggie>{{.veggieName = "banana", .veggieLike = true, .additional_properties = {{"extra", "prop"}}}}};
 
-int main() {}
+int main()
+{
+   out_buffer out;
+   to_json(heck2, out);
+   assert(
+      out.view()
+      == R"({"fruits":["apple","orange","test"],"vegetables":[{"veggieName":"banana","veggieLike":true,"extra":"prop"}]})");
+   // Read back into one object over and over, as a message loop would, keeping the vectors, strings and
+   // additional_properties entries of the last read
+   veggies_and_fruits read_back;
+   for (int i = 0; i < 2; ++i) {
+      from_json_into(read_back, out.view());
+   }
+   assert(read_back.fruits->size() == 3 && read_back.vegetables->size() == 1);
+   assert(std::get<std::string>((*read_back.vegetables)[0].additional_properties.at("extra")) == "prop");
+   out.clear();
+   to_json(heck, out);
+   assert(out.view() == R"({"pain":{"sadness":1}})");
+}
@@ -0,0 +1,556 @@
+#ifndef JSON_SIMD_HPP
+#define JSON_SIMD_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__)
+   #include <immintrin.h>
+#elif defined(__SSE4_2__)
+   #include <nmmintrin.h>
+#elif defined(__SSE2__)
+   #include <emmintrin.h>
+#endif
+
+#if defined(__PCLMUL__)
+   #include <wmmintrin.h>
+#endif
+
+// Stage one of the runtime parser: classify the input 64 bytes at a time and record the position of every
+// structural character outside of strings, every unescaped quote, and the first byte of every scalar
+// (numbers, true, false, null). Stage two only ever looks at these positions. The input is checked to be valid
+// UTF-8 in the same pass.
+
+namespace impl {
+
+struct block_masks {
+   std::uint64_t quote;
+   std::uint64_t backslash;
+   std::uint64_t op;
+   std::uint64_t whitespace;
+};
+
+constexpr block_masks classify_block_scalar(const char* block) noexcept
+{
+   block_masks to_ret{};
+   for (std::size_t i = 0; i < 64; ++i) {
+      const auto bit = std::uint64_t{1} << i;
+      switch (block[i]) {
+      case '"': to_ret.quote |= bit; break;
+      case '\\': to_ret.backslash |= bit; break;
+      case '{':
+      case '}':
+      case '[':
+      case ']':
+      case ':':
+      case ',': to_ret.op |= bit; break;
+      case ' ':
+      case '\f':
+      case '\n':
+      case '\r':
+      case '\t':
+      case '\v': to_ret.whitespace |= bit; break;
+      default: break;
+      }
+   }
+   return to_ret;
+}
+
+#if defined(__AVX2__)
+
+inline std::uint32_t any_of_mask(__m256i chunk, auto... chars) noexcept
+{
+   const auto matches = (_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(chars)) | ...);
+   return static_cast<std::uint32_t>(_mm256_movemask_epi8(matches));
+}
+
+inline block_masks classify_block_simd(const char* block) noexcept
+{
+   const auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+   const auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+   const auto combine = [](std::uint32_t l, std::uint32_t h) { return std::uint64_t{l} | (std::uint64_t{h} << 32); };
+   return {
+      .quote = combine(any_of_mask(lo, '"'), any_of_mask(hi, '"')),
+      .backslash = combine(any_of_mask(lo, '\\'), any_of_mask(hi, '\\')),
+      .op = combine(any_of_mask(lo, '{', '}', '[', ']', ':', ','), any_of_mask(hi, '{', '}', '[', ']', ':', ',')),
+      .whitespace = combine(
+         any_of_mask(lo, ' ', '\f', '\n', '\r', '\t', '\v'), any_of_mask(hi, ' ', '\f', '\n', '\r', '\t', '\v')),
+   };
+}
+
+#elif defined(__SSE4_2__)
+
+inline block_masks classify_block_simd(const char* block) noexcept
+{
+   // Explicit length compares so that embedded nulls don't terminate the match early
+   constexpr int mode = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK;
+   const auto ops = _mm_setr_epi8('{', '}', '[', ']', ':', ',', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+   const auto ws = _mm_setr_epi8(' ', '\f', '\n', '\r', '\t', '\v', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+   const auto quote = _mm_set1_epi8('"');
+   const auto backslash = _mm_set1_epi8('\\');
+   block_masks to_ret{};
+   for (int i = 0; i < 4; ++i) {
+      const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+      const auto shift = i * 16;
+      const auto mask = [&](__m128i m) { return std::uint64_t{static_cast<std::uint16_t>(_mm_cvtsi128_si32(m))}; };
+      to_ret.op |= mask(_mm_cmpestrm(ops, 6, chunk, 16, mode)) << shift;
+      to_ret.whitespace |= mask(_mm_cmpestrm(ws, 6, chunk, 16, mode)) << shift;
+      to_ret.quote |= std::uint64_t{static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)))}
+                   << shift;
+      to_ret.backslash
+         |= std::uint64_t{static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash)))} << shift;
+   }
+   return to_ret;
+}
+
+#endif
+
+constexpr block_masks classify_block(const char* block) noexcept
+{
+#if defined(__AVX2__) || defined(__SSE4_2__)
+   if !consteval {
+      return classify_block_simd(block);
+   }
+#endif
+   return classify_block_scalar(block);
+}
+
+#if defined(__AVX2__)
+
+inline __m256i nibble_lookup(__m256i nibbles, auto... table) noexcept
+{
+   return _mm256_shuffle_epi8(_mm256_setr_epi8(static_cast<char>(table)..., static_cast<char>(table)...), nibbles);
+}
+
+inline __m256i high_nibbles(__m256i v) noexcept { return _mm256_srli_epi16(v, 4) & _mm256_set1_epi8(0x0F); }
+
+// Nonzero bytes wherever input isn't valid UTF-8, given the 32 bytes before it. Each byte is classified by its
+// own high nibble and both nibbles of the byte before, and the three lookups share a set bit only for an invalid
+// pair. From Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte".
+inline __m256i utf8_errors(__m256i input, __m256i prev_input) noexcept
+{
+   constexpr std::uint8_t too_short = 1 << 0;
+   constexpr std::uint8_t too_long = 1 << 1;
+   constexpr std::uint8_t overlong_3 = 1 << 2;
+   constexpr std::uint8_t too_large = 1 << 3;
+   constexpr std::uint8_t surrogate = 1 << 4;
+   constexpr std::uint8_t overlong_2 = 1 << 5;
+   constexpr std::uint8_t too_large_1000 = 1 << 6;
+   constexpr std::uint8_t overlong_4 = 1 << 6;
+   constexpr std::uint8_t two_conts = 1 << 7;
+   constexpr std::uint8_t carry = too_short | too_long | two_conts;
+   constexpr std::uint8_t large = carry | too_large | too_large_1000;
+
+   const auto shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+   const auto prev1 = _mm256_alignr_epi8(input, shifted, 15);
+   const auto prev2 = _mm256_alignr_epi8(input, shifted, 14);
+   const auto prev3 = _mm256_alignr_epi8(input, shifted, 13);
+
+   // clang-format off
+   const auto byte_1_high = nibble_lookup(
+      high_nibbles(prev1),
+      too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+      two_conts, two_conts, two_conts, two_conts,
+      too_short | overlong_2,
+      too_short,
+      too_short | overlong_3 | surrogate,
+      too_short | too_large | too_large_1000 | overlong_4);
+   const auto byte_1_low = nibble_lookup(
+      prev1 & _mm256_set1_epi8(0x0F),
+      carry | overlong_3 | overlong_2 | overlong_4,
+      carry | overlong_2,
+      carry, carry,
+      carry | too_large,
+      large, large, large, large, large, large, large, large,
+      large | surrogate,
+      large, large);
+   const auto byte_2_high = nibble_lookup(
+      high_nibbles(input),
+      too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+      too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4,
+      too_long | overlong_2 | two_conts | overlong_3 | too_large,
+      too_long | overlong_2 | two_conts | surrogate | too_large,
+      too_long | overlong_2 | two_conts | surrogate | too_large,
+      too_short, too_short, too_short, too_short);
+   // clang-format on
+   const auto special = byte_1_high & byte_1_low & byte_2_high;
+
+   // Third and fourth bytes of a sequence have to be continuations as well, which the lookups can't see
+   const auto is_third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+   const auto is_fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+   const auto must_continue = (is_third | is_fourth) & _mm256_set1_epi8(static_cast<char>(0x80));
+   return must_continue ^ special;
+}
+
+// Nonzero if the last bytes of input start a sequence that needs more bytes than are left
+inline __m256i utf8_incomplete(__m256i input) noexcept
+{
+   // clang-format off
+   const auto max = _mm256_setr_epi8(
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+   // clang-format on
+   return _mm256_subs_epu8(input, max);
+}
+
+#endif
+
+// Checks that the input is UTF-8 a 64 byte block at a time, alongside the structural scan. With AVX2, blocks
+// that are all ASCII only need checking for a sequence cut short by the block before.
+class utf8_validator {
+public:
+   constexpr void check(const char* block) noexcept
+   {
+#if defined(__AVX2__)
+      if !consteval {
+         check_simd(block);
+         return;
+      }
+#endif
+      check_scalar(block);
+   }
+
+   // Only errors found so far; a sequence could still be cut short by the end of input
+   constexpr bool failed() const noexcept { return error_; }
+
+   constexpr bool valid_at_end() const noexcept { return !error_ && !incomplete_ && remaining_ == 0; }
+
+private:
+#if defined(__AVX2__)
+   void check_simd(const char* block) noexcept
+   {
+      const auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+      const auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+      if (_mm256_movemask_epi8(lo | hi) == 0) {
+         error_ |= incomplete_;
+         incomplete_ = false;
+      }
+      else {
+         const auto prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_));
+         const auto errors = utf8_errors(lo, prev) | utf8_errors(hi, lo);
+         const auto incomplete = utf8_incomplete(hi);
+         error_ |= _mm256_testz_si256(errors, errors) == 0;
+         incomplete_ = _mm256_testz_si256(incomplete, incomplete) == 0;
+      }
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(prev_), hi);
+   }
+#endif
+
+   // A byte at a time, tracking how many continuation bytes are still owed and the range the next one has to
+   // be in (narrower after E0, ED, F0 and F4, to rule out overlong encodings, surrogates and values past U+10FFFF)
+   constexpr void check_scalar(const char* block) noexcept
+   {
+      for (std::size_t i = 0; i < 64; ++i) {
+         const auto c = static_cast<unsigned char>(block[i]);
+         if (remaining_ == 0) {
+            if (c < 0x80) {
+               continue;
+            }
+            lower_ = 0x80;
+            upper_ = 0xBF;
+            if (c >= 0xC2 && c <= 0xDF) {
+               remaining_ = 1;
+            }
+            else if (c >= 0xE0 && c <= 0xEF) {
+               remaining_ = 2;
+               lower_ = c == 0xE0 ? 0xA0 : 0x80;
+               upper_ = c == 0xED ? 0x9F : 0xBF;
+            }
+            else if (c >= 0xF0 && c <= 0xF4) {
+               remaining_ = 3;
+               lower_ = c == 0xF0 ? 0x90 : 0x80;
+               upper_ = c == 0xF4 ? 0x8F : 0xBF;
+            }
+            else {
+               error_ = true;
+            }
+         }
+         else if (c < lower_ || c > upper_) {
+            error_ = true;
+            remaining_ = 0;
+         }
+         else {
+            lower_ = 0x80;
+            upper_ = 0xBF;
+            remaining_ -= 1;
+         }
+      }
+   }
+
+   bool error_ = false;
+   bool incomplete_ = false;
+   char prev_[32]{};
+   std::uint8_t remaining_ = 0;
+   std::uint8_t lower_ = 0x80;
+   std::uint8_t upper_ = 0xBF;
+};
+
+// Bit i of the result is the XOR of bits [0, i] of the input
+constexpr std::uint64_t prefix_xor(std::uint64_t bits) noexcept
+{
+#if defined(__PCLMUL__)
+   if !consteval {
+      const auto all_ones = _mm_set1_epi8(static_cast<char>(0xFF));
+      const auto product = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<long long>(bits)), all_ones, 0);
+      return static_cast<std::uint64_t>(_mm_cvtsi128_si64(product));
+   }
+#endif
+   bits ^= bits << 1;
+   bits ^= bits << 2;
+   bits ^= bits << 4;
+   bits ^= bits << 8;
+   bits ^= bits << 16;
+   bits ^= bits << 32;
+   return bits;
+}
+
+// Returns the characters that are escaped by a preceding backslash, i.e., the odd-length tails of backslash
+// runs. prev_escaped carries a dangling escape over to the next block.
+constexpr std::uint64_t find_escaped(std::uint64_t backslash, std::uint64_t& prev_escaped) noexcept
+{
+   constexpr std::uint64_t even_bits = 0x5555'5555'5555'5555;
+   backslash &= ~prev_escaped;
+   const auto follows_escape = (backslash << 1) | prev_escaped;
+   const auto odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+   const auto sequences_starting_on_even_bits = odd_sequence_starts + backslash;
+   prev_escaped = sequences_starting_on_even_bits < odd_sequence_starts ? 1 : 0;
+   const auto invert_mask = sequences_starting_on_even_bits << 1;
+   return (even_bits ^ invert_mask) & follows_escape;
+}
+
+struct structural_scanner {
+   std::uint64_t prev_escaped = 0;
+   std::uint64_t prev_in_string = 0;
+   std::uint64_t prev_scalar = 0;
+   // Strings can only contain escape sequences once this is set
+   bool saw_backslash = false;
+   utf8_validator utf8;
+
+   // Classifies and validates one block
+   constexpr std::uint64_t scan(const char* block) noexcept
+   {
+      utf8.check(block);
+      const auto masks = classify_block(block);
+      saw_backslash |= masks.backslash != 0;
+      return next(masks);
+   }
+
+   // Once the input has been scanned
+   constexpr void finish() const
+   {
+      if (prev_in_string != 0) {
+         throw std::runtime_error{"unterminated string"};
+      }
+      if (!utf8.valid_at_end()) {
+         throw std::runtime_error{"invalid UTF-8"};
+      }
+   }
+
+   constexpr std::uint64_t next(const block_masks& block) noexcept
+   {
+      const auto escaped = find_escaped(block.backslash, prev_escaped);
+      const auto quote = block.quote & ~escaped;
+      // Includes the opening quote but not the closing one
+      const auto in_string = prefix_xor(quote) ^ prev_in_string;
+      prev_in_string = static_cast<std::uint64_t>(static_cast<std::int64_t>(in_string) >> 63);
+      const auto scalar = ~(block.op | block.whitespace | quote) & ~in_string;
+      const auto scalar_start = scalar & ~((scalar << 1) | prev_scalar);
+      prev_scalar = scalar >> 63;
+      return (block.op & ~in_string) | quote | scalar_start;
+   }
+};
+
+// Writes the positions in groups of eight so the common case is branch free; indexes must have room for
+// 64 more entries past write_loc
+constexpr std::size_t append_indexes(std::uint32_t* indexes, std::uint32_t base, std::uint64_t bits) noexcept
+{
+   const auto count = static_cast<std::size_t>(std::popcount(bits));
+   for (std::size_t i = 0; i < count; i += 8) {
+      for (std::size_t j = 0; j < 8; ++j) {
+         indexes[i + j] = base + static_cast<std::uint32_t>(std::countr_zero(bits));
+         bits &= bits - 1;
+      }
+   }
+   return count;
+}
+
+} // namespace impl
+
+// Positions of all structural characters in v, in order. Reusing the same vector across documents avoids
+// touching fresh memory on every call.
+constexpr void find_structural_indexes(const std::string_view v, std::vector<std::uint32_t>& indexes)
+{
+   if (v.size() >= std::numeric_limits<std::uint32_t>::max()) {
+      throw std::runtime_error{"JSON input too large"};
+   }
+   indexes.resize(std::max(indexes.capacity(), v.size() / 4 + 128));
+   std::size_t count = 0;
+   impl::structural_scanner scanner;
+   const auto add_block = [&](const char* block, std::size_t base) {
+      if (count + 64 > indexes.size()) {
+         indexes.resize(indexes.size() * 2);
+      }
+      const auto bits = scanner.scan(block);
+      count += impl::append_indexes(indexes.data() + count, static_cast<std::uint32_t>(base), bits);
+   };
+   std::size_t index = 0;
+   for (; index + 64 <= v.size(); index += 64) {
+      add_block(v.data() + index, index);
+   }
+   if (index < v.size()) {
+      // Pad the tail with whitespace, which is never structural
+      char tail[64];
+      std::ranges::fill(tail, ' ');
+      std::ranges::copy(v.substr(index), tail);
+      add_block(tail, index);
+   }
+   indexes.resize(count);
+   scanner.finish();
+}
+
+constexpr std::vector<std::uint32_t> find_structural_indexes(const std::string_view v)
+{
+   std::vector<std::uint32_t> to_ret;
+   find_structural_indexes(v, to_ret);
+   return to_ret;
+}
+
+// The same positions as find_structural_indexes, but scanned a window at a time as they're consumed, so memory
+// use doesn't grow with the input
+class structural_index_stream {
+public:
+   constexpr explicit structural_index_stream(const std::string_view v, std::size_t window_blocks = 1024)
+      : json_{v}
+   {
+      if (v.size() >= std::numeric_limits<std::uint32_t>::max()) {
+         throw std::runtime_error{"JSON input too large"};
+      }
+      window_blocks_ = std::max<std::size_t>(1, std::min(window_blocks, (v.size() + 63) / 64));
+      indexes_.resize(window_blocks_ * 64);
+   }
+
+   // The input size once every position has been consumed
+   constexpr std::uint32_t peek()
+   {
+      if (head_ == count_ && !refill()) {
+         return static_cast<std::uint32_t>(json_.size());
+      }
+      return indexes_[head_];
+   }
+
+   constexpr std::uint32_t next()
+   {
+      if (head_ == count_ && !refill()) {
+         throw std::runtime_error{"unexpected end of JSON input"};
+      }
+      return indexes_[head_++];
+   }
+
+   constexpr bool at_end() { return head_ == count_ && !refill(); }
+
+   constexpr std::string_view json() const noexcept { return json_; }
+
+   // Whether any of the input consumed so far contains a backslash; strings before the first one can't have
+   // escape sequences
+   constexpr bool saw_backslash() const noexcept { return scanner_.saw_backslash; }
+
+private:
+   constexpr bool refill()
+   {
+      head_ = 0;
+      count_ = 0;
+      while (count_ == 0 && scanned_ < json_.size()) {
+         for (std::size_t i = 0; i < window_blocks_ && scanned_ < json_.size(); ++i, scanned_ += 64) {
+            std::uint64_t bits;
+            if (scanned_ + 64 <= json_.size()) {
+               bits = scanner_.scan(json_.data() + scanned_);
+            }
+            else {
+               char tail[64];
+               std::ranges::fill(tail, ' ');
+               std::ranges::copy(json_.substr(scanned_), tail);
+               bits = scanner_.scan(tail);
+            }
+            count_ += impl::append_indexes(indexes_.data() + count_, static_cast<std::uint32_t>(scanned_), bits);
+         }
+         if (scanner_.utf8.failed()) {
+            throw std::runtime_error{"invalid UTF-8"};
+         }
+         if (scanned_ >= json_.size()) {
+            scanner_.finish();
+         }
+      }
+      return count_ != 0;
+   }
+
+   std::string_view json_;
+   std::vector<std::uint32_t> indexes_;
+   std::size_t window_blocks_;
+   std::size_t head_ = 0;
+   std::size_t count_ = 0;
+   std::size_t scanned_ = 0;
+   impl::structural_scanner scanner_;
+};
+
+namespace impl {
+
+constexpr bool is_escapable(char c) noexcept
+{
+   return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+constexpr bool is_whitespace(char c) noexcept
+{
+   return c == ' ' || c == '\f' || c == '\n' || c == '\r' || c == '\t' || c == '\v';
+}
+
+} // namespace impl
+
+// First character in [first, last) that can't appear unescaped in a JSON string (a quote, backslash or
+// control character), or last if there are none
+constexpr const char* find_escapable(const char* first, const char* last) noexcept
+{
+   if !consteval {
+#if defined(__AVX2__)
+      const auto quote = _mm256_set1_epi8('"');
+      const auto backslash = _mm256_set1_epi8('\\');
+      const auto control_max = _mm256_set1_epi8(0x1F);
+      for (; last - first >= 32; first += 32) {
+         const auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+         // Unsigned chunk <= 0x1F is the same as max(chunk, 0x1F) == 0x1F
+         const auto matches = _mm256_cmpeq_epi8(chunk, quote) | _mm256_cmpeq_epi8(chunk, backslash)
+                            | _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, control_max), control_max);
+         if (const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(matches)); mask != 0) {
+            return first + std::countr_zero(mask);
+         }
+      }
+#endif
+#if defined(__SSE2__)
+      const auto quote16 = _mm_set1_epi8('"');
+      const auto backslash16 = _mm_set1_epi8('\\');
+      const auto control_max16 = _mm_set1_epi8(0x1F);
+      for (; last - first >= 16; first += 16) {
+         const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+         const auto matches = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote16), _mm_cmpeq_epi8(chunk, backslash16)),
+            _mm_cmpeq_epi8(_mm_max_epu8(chunk, control_max16), control_max16));
+         if (const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(matches)); mask != 0) {
+            return first + std::countr_zero(mask);
+         }
+      }
+#endif
+   }
+   while (first != last && !impl::is_escapable(*first)) {
+      ++first;
+   }
+   return first;
+}
+
+#endif // JSON_SIMD_HPP
@@ -0,0 +1,188 @@
+#ifndef JSON_STRING_HPP
+#define JSON_STRING_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Scratch space for decoded strings. Memory is handed out from large chunks, so views into it stay valid until
+// clear() or destruction, and clear() keeps the chunks so that reusing an arena across documents doesn't
+// allocate once it's warmed up.
+class json_string_arena {
+public:
+   constexpr explicit json_string_arena(std::size_t chunk_size = 1 << 16) : chunk_size_{chunk_size} {}
+
+   // Room for n characters
+   constexpr char* allocate(std::size_t n)
+   {
+      while (current_ < chunks_.size() && used_ + n > chunks_[current_].size) {
+         current_ += 1;
+         used_ = 0;
+      }
+      if (current_ == chunks_.size()) {
+         const auto size = std::max(chunk_size_, n);
+         chunks_.push_back({std::make_unique_for_overwrite<char[]>(size), size});
+      }
+      const auto to_ret = chunks_[current_].data.get() + used_;
+      used_ += n;
+      return to_ret;
+   }
+
+   // Hands back the unused end of the most recent allocation
+   constexpr void shrink_last(std::size_t unused) noexcept { used_ -= unused; }
+
+   // Invalidates everything decoded so far, but keeps the memory
+   constexpr void clear() noexcept
+   {
+      current_ = 0;
+      used_ = 0;
+   }
+
+private:
+   struct chunk {
+      std::unique_ptr<char[]> data;
+      std::size_t size;
+   };
+
+   std::vector<chunk> chunks_;
+   std::size_t chunk_size_;
+   std::size_t current_ = 0;
+   std::size_t used_ = 0;
+};
+
+namespace impl {
+
+// Writes the UTF-8 encoding of the code point and returns the end
+constexpr char* encode_utf8(char* out, std::uint32_t code_point) noexcept
+{
+   if (code_point < 0x80) {
+      *out++ = static_cast<char>(code_point);
+   }
+   else if (code_point < 0x800) {
+      *out++ = static_cast<char>(0xC0 | (code_point >> 6));
+      *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+   }
+   else if (code_point < 0x10000) {
+      *out++ = static_cast<char>(0xE0 | (code_point >> 12));
+      *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+      *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+   }
+   else {
+      *out++ = static_cast<char>(0xF0 | (code_point >> 18));
+      *out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+      *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+      *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+   }
+   return out;
+}
+
+// Decodes the escape sequences of a raw JSON string (without its quotes) to out and returns the end. No escape
+// sequence is shorter than what it decodes to, so raw.size() characters of room is always enough.
+constexpr char* unescape_json_string(const std::string_view raw, char* out)
+{
+   const auto read_hex4 = [&](std::size_t at) -> std::uint32_t {
+      if (at + 4 > raw.size()) {
+         throw std::runtime_error{"truncated unicode escape"};
+      }
+      std::uint32_t to_ret = 0;
+      for (const char c : raw.substr(at, 4)) {
+         const auto lower = static_cast<char>(c | 0x20);
+         if (c >= '0' && c <= '9') {
+            to_ret = to_ret * 16 + static_cast<std::uint32_t>(c - '0');
+         }
+         else if (lower >= 'a' && lower <= 'f') {
+            to_ret = to_ret * 16 + static_cast<std::uint32_t>(lower - 'a' + 10);
+         }
+         else {
+            throw std::runtime_error{"invalid unicode escape"};
+         }
+      }
+      return to_ret;
+   };
+   std::size_t index = 0;
+   while (true) {
+      // Runs between escapes are found with a vectorized memchr and copied in one go
+      const auto escape = raw.find('\\', index);
+      out = std::ranges::copy(raw.substr(index, escape - index), out).out;
+      if (escape == std::string_view::npos) {
+         return out;
+      }
+      if (escape + 1 == raw.size()) {
+         throw std::runtime_error{"unterminated escape sequence"};
+      }
+      index = escape + 2;
+      switch (raw[escape + 1]) {
+      case '"': *out++ = '"'; break;
+      case '\\': *out++ = '\\'; break;
+      case '/': *out++ = '/'; break;
+      case 'b': *out++ = '\b'; break;
+      case 'f': *out++ = '\f'; break;
+      case 'n': *out++ = '\n'; break;
+      case 'r': *out++ = '\r'; break;
+      case 't': *out++ = '\t'; break;
+      case 'u': {
+         auto code_point = read_hex4(index);
+         index += 4;
+         if (code_point >= 0xD800 && code_point < 0xDC00) {
+            if (!raw.substr(index).starts_with("\\u")) {
+               throw std::runtime_error{"unpaired surrogate in unicode escape"};
+            }
+            const auto low = read_hex4(index + 2);
+            if (low < 0xDC00 || low >= 0xE000) {
+               throw std::runtime_error{"unpaired surrogate in unicode escape"};
+            }
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+            index += 6;
+         }
+         else if (code_point >= 0xDC00 && code_point < 0xE000) {
+            throw std::runtime_error{"unpaired surrogate in unicode escape"};
+         }
+         out = encode_utf8(out, code_point);
+         break;
+      }
+      default: throw std::runtime_error{"invalid escape sequence"};
+      }
+   }
+}
+
+constexpr std::string_view decode_escaped(const std::string_view raw, json_string_arena& arena)
+{
+   const auto first = arena.allocate(raw.size());
+   const auto last = unescape_json_string(raw, first);
+   arena.shrink_last(raw.size() - static_cast<std::size_t>(last - first));
+   return {first, last};
+}
+
+} // namespace impl
+
+// The text of a raw JSON string (without its quotes): raw itself when it has no escape sequences, otherwise
+// its decoded copy in arena
+constexpr std::string_view decode_json_string(const std::string_view raw, json_string_arena& arena)
+{
+   if (raw.find('\\') == std::string_view::npos) {
+      return raw;
+   }
+   return impl::decode_escaped(raw, arena);
+}
+
+// Appends the UTF-8 encoding of the code point to out
+constexpr void append_utf8(std::string& out, std::uint32_t code_point)
+{
+   char buffer[4];
+   out.append(buffer, impl::encode_utf8(buffer, code_point));
+}
+
+// Decodes the escape sequences of a raw JSON string (without its quotes) onto the end of out
+constexpr void append_unescaped(std::string& out, const std::string_view raw)
+{
+   const auto old_size = out.size();
+   out.resize(old_size + raw.size());
+   const auto last = impl::unescape_json_string(raw, out.data() + old_size);
+   out.resize(static_cast<std::size_t>(last - out.data()));
+}
+
+#endif // JSON_STRING_HPP
@@ -1,6 +1,17 @@
 #include "common.hpp"
+#include "json_cache.hpp"
+#include "json_dom.hpp"
+#include "json_edit.hpp"
+#include "json_format.hpp"
+#include "json_index.hpp"
+#include "json_lazy.hpp"
 #include "json_parse.hpp"
-#include "runtime_setter_stuff.hpp"
+#include "json_path.hpp"
+#include "json_push.hpp"
+#include "json_reflect.hpp"
+#include "json_rows.hpp"
+#include "json_sax.hpp"
+#include "json_tape.hpp"
 
 static_assert(parse_json("123") == json_value{123});
 static_assert(parse_json(R"( "123" )") == json_value{"123"});
@@ -8,65 +19,145 @@ static_assert(parse_json("[1, 2, 3]") == json_value{std::vector<json_value>{1, 2
 static_assert(
    parse_json("{\"a\": 123}") == json_value{std::vector<std::pair<std::string_view, json_value>>{{"a", 123}}});
 
-constexpr auto type_mapping = std::to_array<std::pair<std::string_view, std::meta::info>>({
-   {"i8", ^^tdef<std::int8_t>::type},
-   {"i16", ^^tdef<std::int16_t>::type},
-   {"i32", ^^tdef<std::int32_t>::type},
-   {"i64", ^^tdef<std::int64_t>::type},
-   {"u8", ^^tdef<std::uint8_t>::type},
-   {"u16", ^^tdef<std::uint16_t>::type},
-   {"u32", ^^tdef<std::uint32_t>::type},
-   {"u64", ^^tdef<std::uint64_t>::type},
-});
-
-consteval std::meta::info make_struct_from_json(std::meta::info to_complete, const std::string_view json_str)
-{
-   const auto json = parse_json(json_str);
-   const auto& format_info = get_by_key(std::get<json_map>(json), "format");
-   std::vector<std::meta::info> members;
-   for (const auto& [name, type_raw] : std::get<json_map>(format_info)) {
-      const auto& type = std::get<std::string_view>(type_raw);
-      members.push_back(std::meta::data_member_spec(get_by_key(type_mapping, type), {.name = name}));
-   }
-   return std::meta::define_aggregate(to_complete, members);
-}
-
-template<typename T>
-consteval auto make_data_from_json(const std::string_view json_str)
-{
-   const auto json = parse_json(json_str);
-   const auto& data_info = get_by_key(std::get<json_map>(json), "data");
-   std::vector<T> to_ret;
-   for (const auto& data : std::get<std::vector<json_value>>(data_info)) {
-      T to_add;
-      for (const auto& [name, value] : std::get<json_map>(data)) {
-         // TODO: more complicated stuff
-         set_by_name(to_add, name, std::get<std::int64_t>(value));
-      }
-      to_ret.push_back(to_add);
+static_assert(
+   parse_json("[1.5, -2e-3, 12345678901234567890]") == json_value{json_array{1.5, -2e-3, 12345678901234567890.0}});
+// Halfway between 1 and the next double up, then just past it; only the 54th significant digit tells them apart
+static_assert(parse_json("1.000000000000000111022302462515654042363166809082031250") == json_value{1.0});
+static_assert(parse_json("1.000000000000000111022302462515654042363166809082031251") == json_value{1.0000000000000002});
+
+static_assert([] {
+   json_string_arena arena;
+   const auto json = parse_json(R"({"a\"b": ["\"q\"", "\ud83d\ude00 \u00e9", "plain"]})", arena);
+   const auto& map = std::get<json_map>(json);
+   return map[0].first == "a\"b" && map[0].second == json_value{json_array{"\"q\"", "\U0001F600 \u00e9", "plain"}};
+}());
+
+static_assert(get<std::int64_t>(parse_json_tape("123").root()) == 123);
+static_assert(get<double>(parse_json_tape("0.1").root()) == 0.1);
+static_assert(get<tape_array>(parse_json_tape("[1, [2, 3], 4]").root()).size() == 3);
+static_assert(get<std::int64_t>(get<tape_array>(parse_json_tape("[1, [2, 3], 4]").root())[2]) == 4);
+static_assert(
+   get<std::string_view>(get_by_key(get<tape_map>(parse_json_tape(R"({"a": {}, "b": "c"})").root()), "b")) == "c");
+// The same literal gives back the same static tape
+static_assert(get<std::int64_t>(get_by_key(get<tape_map>(parse_json_once<R"({"a": 1})">()), "a")) == 1);
+static_assert(parse_json_once<"[1, 2]">() == parse_json_once<"[1, 2]">());
+
+// Only the inner array is parsed again, and the tape comes out as a full parse of the edited text would make it
+static_assert([] {
+   json_editable_document doc{R"({"a": [1, 2, {"b": "c"}], "d": [true]})"};
+   doc.replace(doc.text().find('2'), 1, R"("two", [3])");
+   const auto a = get<tape_array>(get_by_key(get<tape_map>(doc.root()), "a"));
+   return get<std::string_view>(a[1]) == "two" && doc.entries() == parse_json_tape(doc.text()).entries();
+}());
+
+// Members and elements relinked in place; short strings live in their nodes and longer new ones are copied
+static_assert([] {
+   json_dom doc{R"({"a": [1, 2, {"b": "c"}], "secret": "a long secret string", "d": [true, null], "e": "x\"y"})"};
+   auto root = get<dom_map>(doc.root());
+   root.erase("secret");
+   root["added"].set("a long string of its own");
+   get<dom_array>(root["a"]).insert(1).set(std::int64_t{7});
+   get<dom_array>(root["a"]).erase(0);
+   get<dom_array>(root["d"]).push_back().set_object()["k"].set(false);
+   get_by_key(get<dom_map>(get<dom_array>(root["a"])[2]), "b").set(nullptr);
+   return to_json_string(doc.root())
+       == R"({"a":[7,2,{"b":null}],"d":[true,null,{"k":false}],"e":"x\"y","added":"a long string of its own"})";
+}());
+
+// Only the path to "list" and "s" is looked at; "skip" is stepped over by bracket matching
+static_assert([] {
+   const auto doc = parse_json_lazy(R"({"skip": {"a": [1, "]}", {"b": null}]}, "list": [10, 2.5, true], "s": "x"})");
+   const auto root = get<lazy_map>(doc.root());
+   const auto list = get<lazy_array>(root["list"]);
+   return get<std::int64_t>(list[0]) == 10 && get<double>(list[1]) == 2.5 && get<bool>(list[2])
+       && get<std::string_view>(get_by_key(root, "s")) == "x" && !get_by_key_opt(root, "t")
+       && get<lazy_map>(root["skip"])["a"].source() == R"([1, "]}", {"b": null}])";
+}());
+
+// The same path against a tree, a lazy document and the raw text, where the walk never reaches the unfinished "junk"
+static_assert([] {
+   constexpr std::string_view text = R"({"a/b": [{"c": 1}], "list": [10, {"x": "y"}], "junk": [)";
+   constexpr std::string_view complete = R"({"a/b": [{"c": 1}], "list": [10, {"x": "y"}]})";
+   const auto path = json_path{"list[1].x"};
+   return get_by_path(parse_json(complete), path) == json_value{"y"}
+       && get<std::string_view>(get_by_path(parse_json_lazy(complete).root(), path)) == "y"
+       && find_by_path(text, path) == R"("y")" && find_by_path(text, compiled_json_path<"/a~1b/0">) == R"({"c": 1})"
+       && !find_by_path(text, json_path{"/list/2"}) && json_path{"#/$defs/a%20b"}.key(1) == "a b";
+}());
+
+// Escaped keys match the path's decoded ones in each form
+static_assert([] {
+   constexpr std::string_view text = R"({"a\/b": {"x\u0041": 1, "\ud83d\ude00": 2}})";
+   const auto path = json_path{"/a~1b/xA"};
+   return std::get<std::int64_t>(get_by_path(parse_json(text), path)) == 1
+       && get<std::int64_t>(get_by_path(parse_json_lazy(text).root(), path)) == 1 && find_by_path(text, path) == "1"
+       && find_by_path(text, json_path{"/a~1b/\U0001F600"}) == "2"
+       && !get_by_path_opt(parse_json(text), json_path{"/a~1b/xB"});
+}());
+
+// The cache's hash can be taken in constant evaluation too, and the zeros a short last block is padded with don't
+// make a document hash like the same one followed by zeros
+static_assert(impl::hash_bytes(R"({"service": "a", "seq": 1})") != impl::hash_bytes(R"({"service": "a", "seq": 2})"));
+static_assert(impl::hash_bytes(std::string_view{"[1]\0", 4}) != impl::hash_bytes("[1]"));
+
+struct int_summer {
+   std::int64_t sum = 0;
+
+   constexpr void on_object_begin() {}
+   constexpr void on_object_end() {}
+   constexpr void on_array_begin() {}
+   constexpr void on_array_end() {}
+   constexpr void on_key(std::string_view) {}
+   constexpr void on_string(std::string_view) {}
+   constexpr void on_int64(std::int64_t v) { sum += v; }
+   constexpr void on_double(double) {}
+   constexpr void on_bool(bool) {}
+   constexpr void on_null() {}
+};
+
+static_assert([] {
+   int_summer summer;
+   parse_json_events(R"({"a": [1, 2, {"b": 3}], "c": "4", "d": null})", summer);
+   return summer.sum == 6;
+}());
+
+// Nested further than constant evaluation allows calls to be, so this only works without recursion
+static_assert([] {
+   int_summer summer;
+   const auto deep = std::string(2000, '[') + "1" + std::string(2000, ']');
+   parse_json_events(deep, summer, {.max_depth = 2000});
+   return summer.sum == 1;
+}());
+
+static_assert([] {
+   int_summer summer;
+   json_push_parser parser{summer};
+   for (const auto chunk : {R"({"a": [1)", R"(2, {"b\)", R"(\": 3}], "c": "4", "d": nu)", "ll}"}) {
+      parser.feed(chunk);
    }
-   return ::define_static_array(to_ret);
-}
+   parser.finish();
+   return summer.sum == 15;
+}());
 
-constexpr const char struct_info[]{
-   R"(
-   {
-      "format": {
-         "x": "i32",
-         "y": "i32"
-      },
-      "data": [
-         {
-            "x": 1,
-            "y": 1
-         },
-         {
-            "x": 2,
-            "y": 2
-         }
-      ]
+static_assert([] {
+   std::vector<std::string> names;
+   json_map map;
+   for (char c = 'a'; c <= 'z'; ++c) {
+      names.push_back(std::string{"key_"} + c);
    }
-   )"};
+   for (std::size_t i = 0; i < names.size(); ++i) {
+      map.emplace_back(names[i], static_cast<std::int64_t>(i));
+   }
+   map.emplace_back("key_a", 100);
+   const auto index = json_map_index{map};
+   return index.is_hashed() && get_by_key(index, "key_a") == json_value{0}
+       && get_by_key(index, "key_z") == json_value{25} && get_by_key_opt(index, "key_") == nullptr;
+}());
+
+// Kept in src/data, the '\0' makes it a string like the literal it used to be
+constexpr char struct_info[]{
+#embed "data/struct_info.json" suffix(, '\0')
+};
 
 struct point;
 consteval { make_struct_from_json(^^point, struct_info); }
@@ -74,4 +165,90 @@ constexpr auto data = make_data_from_json<point>(struct_info);
 
 static_assert(data.size() == 2 && data[0].x == 1 && data[0].y == 1 && data[1].x == 2 && data[1].y == 2);
 
+// The same rows as json_pack would pack them, read back without parsing anything
+static_assert(matches_packed_layout<point>(struct_info));
+static_assert([] {
+   constexpr auto image = std::bit_cast<std::array<unsigned char, 16>>(std::array<std::int32_t, 4>{1, 1, 2, 2});
+   const auto packed = packed_rows<point>{image};
+   std::int32_t sum = 0;
+   for (const auto row : packed) {
+      sum += row.x * row.y;
+   }
+   return packed.size() == 2 && packed[1].y == 2 && sum == 5;
+}());
+
+// The same rows one at a time, without a vector to hold them
+static_assert([] {
+   std::int32_t sum = 0;
+   for (const auto& row : rows<point>(struct_info)) {
+      sum += row.x + row.y;
+   }
+   return sum == 6;
+}());
+
+static_assert([] {
+   std::string out;
+   to_json(data[1], out);
+   return out == R"({"x":2,"y":2})";
+}());
+
+struct nested_example {
+   struct item {
+      std::int32_t a;
+      std::optional<std::string> b;
+   };
+   std::vector<item> items;
+   std::string name;
+   bool flag;
+};
+
+static_assert([] {
+   const auto value = from_json<nested_example>(R"(
+   {
+      "name": "escaped \"name\" \u00e9",
+      "unknown": [1, {"c": "]"}],
+      "items": [{"a": 1}, {"a": 2, "b": "x"}, {"a": 3, "b": null}],
+      "flag": true
+   })");
+   return value.name == "escaped \"name\" \u00e9" && value.items.size() == 3 && value.items[0].a == 1
+       && !value.items[0].b && value.items[1].b == "x" && !value.items[2].b && value.flag;
+}());
+
+// Members a row doesn't have come out as from_json would leave them, not as the row before had them
+static_assert([] {
+   std::int32_t sum = 0;
+   std::size_t missing = 0;
+   for (const auto& row : rows<nested_example::item>(R"([{"a": 1, "b": "x"}, {"a": 2}, {}])", "")) {
+      sum += row.a;
+      missing += row.b ? 0 : 1;
+   }
+   return sum == 3 && missing == 2;
+}());
+
+// Read over a value of another shape, everything the second document doesn't have is as from_json would leave it
+static_assert([] {
+   nested_example value;
+   from_json_into(value, R"({"items": [{"a": 1, "b": "x"}, {"a": 2}, {"a": 3}], "name": "first", "flag": true})");
+   from_json_into(value, R"({"items": [{"a": 4}, {"a": 5, "b": "y"}], "flag": false})");
+   return value.items.size() == 2 && value.items[0].a == 4 && !value.items[0].b && value.items[1].b == "y"
+       && value.name.empty() && !value.flag;
+}());
+
+struct telemetry {
+   double value;
+   std::vector<double> samples;
+};
+
+static_assert([] {
+   const auto value = from_json<telemetry>(R"({"value": 2.5e1, "samples": [1, 0.5, -1e-2, 1e400]})");
+   return value.value == 25 && value.samples.size() == 4 && value.samples[1] == 0.5 && value.samples[2] == -0.01
+       && value.samples[3] == std::numeric_limits<double>::infinity();
+}());
+
+static_assert([] {
+   std::string out;
+   to_json(nested_example{.items = {{.a = 1}, {.a = 2, .b = "x\ny"}}, .name = "\"n\"", .flag = false}, out);
+   return out == R"({"items":[{"a":1},{"a":2,"b":"x\ny"}],"name":"\"n\"","flag":false})";
+}());
+
 int main() {}
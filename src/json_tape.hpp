@@ -0,0 +1,467 @@
+#ifndef JSON_TAPE_HPP
+#define JSON_TAPE_HPP
+
+#include "common.hpp"
+#include "json_parse.hpp"
+#include "json_sax.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+// A flat alternative to json_value: the whole document is a single array of tagged 64-bit entries.
+// The top byte of an entry is its tag and the low 56 bits are its payload.
+//
+//  tag | payload                                       | following entry
+//  ----+-----------------------------------------------+----------------
+//   l  | unused                                        | the std::int64_t value
+//   d  | unused                                        | the bits of the double
+//   "  | offset of the string into the source          | the string's length
+//   t  | unused                                        |
+//   f  | unused                                        |
+//   n  | unused                                        |
+//   {  | low 32 bits: index one past the matching }    |
+//      | high 24 bits: member count (saturating)       |
+//   }  | index of the matching {                       |
+//   [  | same as {                                     |
+//   ]  | index of the matching [                       |
+//
+// Strings refer back into the source text, so it must outlive the tape.
+
+enum class tape_tag : char {
+   int64 = 'l',
+   double_value = 'd',
+   string = '"',
+   true_value = 't',
+   false_value = 'f',
+   null_value = 'n',
+   object_begin = '{',
+   object_end = '}',
+   array_begin = '[',
+   array_end = ']',
+};
+
+namespace impl {
+
+inline constexpr std::uint64_t payload_mask = (std::uint64_t{1} << 56) - 1;
+inline constexpr std::uint64_t count_max = (std::uint64_t{1} << 24) - 1;
+
+constexpr std::uint64_t make_entry(tape_tag tag, std::uint64_t payload) noexcept
+{
+   return (static_cast<std::uint64_t>(static_cast<unsigned char>(tag)) << 56) | (payload & payload_mask);
+}
+
+constexpr tape_tag tag_of(std::uint64_t entry) noexcept
+{
+   return static_cast<tape_tag>(static_cast<char>(entry >> 56));
+}
+
+constexpr std::uint64_t payload_of(std::uint64_t entry) noexcept { return entry & payload_mask; }
+
+} // namespace impl
+
+class tape_map;
+class tape_array;
+
+class tape_value {
+public:
+   constexpr tape_value(const std::uint64_t* tape, const std::uint64_t* entry, std::string_view source) noexcept
+      : tape_{tape}
+      , entry_{entry}
+      , source_{source}
+   {
+   }
+
+   constexpr tape_tag tag() const noexcept { return impl::tag_of(*entry_); }
+
+   template<typename T>
+   constexpr bool holds() const noexcept
+   {
+      const auto t = tag();
+      if constexpr (std::same_as<T, std::int64_t>) {
+         return t == tape_tag::int64;
+      }
+      else if constexpr (std::same_as<T, double>) {
+         return t == tape_tag::double_value;
+      }
+      else if constexpr (std::same_as<T, bool>) {
+         return t == tape_tag::true_value || t == tape_tag::false_value;
+      }
+      else if constexpr (std::same_as<T, std::nullptr_t>) {
+         return t == tape_tag::null_value;
+      }
+      else if constexpr (std::same_as<T, std::string_view>) {
+         return t == tape_tag::string;
+      }
+      else if constexpr (std::same_as<T, tape_map>) {
+         return t == tape_tag::object_begin;
+      }
+      else if constexpr (std::same_as<T, tape_array>) {
+         return t == tape_tag::array_begin;
+      }
+      else {
+         static_assert(false, "not a JSON value type");
+      }
+   }
+
+   // Entry after this value and all of its children
+   constexpr const std::uint64_t* next_entry() const noexcept
+   {
+      switch (tag()) {
+      case tape_tag::int64:
+      case tape_tag::double_value:
+      case tape_tag::string: return entry_ + 2;
+      case tape_tag::object_begin:
+      case tape_tag::array_begin: return tape_ + (impl::payload_of(*entry_) & 0xFFFF'FFFF);
+      default: return entry_ + 1;
+      }
+   }
+
+   constexpr const std::uint64_t* entry() const noexcept { return entry_; }
+
+   friend constexpr bool operator==(const tape_value& lhs, const tape_value& rhs) noexcept
+   {
+      return lhs.entry_ == rhs.entry_;
+   }
+
+private:
+   template<typename T>
+   friend constexpr T get(const tape_value& v);
+
+   friend class tape_map;
+   friend class tape_array;
+
+   const std::uint64_t* tape_;
+   const std::uint64_t* entry_;
+   std::string_view source_;
+};
+
+// Forward range over the (key, value) pairs of an object, in document order
+class tape_map {
+public:
+   class iterator {
+   public:
+      using value_type = std::pair<std::string_view, tape_value>;
+      using difference_type = std::ptrdiff_t;
+
+      constexpr iterator() noexcept = default;
+
+      constexpr iterator(const std::uint64_t* tape, const std::uint64_t* entry, std::string_view source) noexcept
+         : tape_{tape}
+         , entry_{entry}
+         , source_{source}
+      {
+      }
+
+      constexpr value_type operator*() const noexcept
+      {
+         const auto key = source_.substr(impl::payload_of(entry_[0]), entry_[1]);
+         return {key, tape_value{tape_, entry_ + 2, source_}};
+      }
+
+      constexpr iterator& operator++() noexcept
+      {
+         entry_ = tape_value{tape_, entry_ + 2, source_}.next_entry();
+         return *this;
+      }
+
+      constexpr iterator operator++(int) noexcept
+      {
+         auto to_ret = *this;
+         ++*this;
+         return to_ret;
+      }
+
+      friend constexpr bool operator==(const iterator& lhs, const iterator& rhs) noexcept
+      {
+         return lhs.entry_ == rhs.entry_;
+      }
+
+   private:
+      const std::uint64_t* tape_ = nullptr;
+      const std::uint64_t* entry_ = nullptr;
+      std::string_view source_;
+   };
+
+   constexpr explicit tape_map(const tape_value& v) noexcept : value_{v} {}
+
+   constexpr iterator begin() const noexcept { return {value_.tape_, value_.entry_ + 1, value_.source_}; }
+   constexpr iterator end() const noexcept { return {value_.tape_, value_.next_entry() - 1, value_.source_}; }
+
+   // Only exact below 2^24 members; larger objects have to be counted
+   constexpr std::size_t size() const noexcept
+   {
+      const auto count = impl::payload_of(*value_.entry_) >> 32;
+      return count < impl::count_max ? count : static_cast<std::size_t>(std::ranges::distance(begin(), end()));
+   }
+
+   constexpr bool empty() const noexcept { return begin() == end(); }
+
+private:
+   tape_value value_;
+};
+
+// Forward range over the values of an array
+class tape_array {
+public:
+   class iterator {
+   public:
+      using value_type = tape_value;
+      using difference_type = std::ptrdiff_t;
+
+      constexpr iterator() noexcept = default;
+
+      constexpr iterator(const std::uint64_t* tape, const std::uint64_t* entry, std::string_view source) noexcept
+         : tape_{tape}
+         , entry_{entry}
+         , source_{source}
+      {
+      }
+
+      constexpr value_type operator*() const noexcept { return tape_value{tape_, entry_, source_}; }
+
+      constexpr iterator& operator++() noexcept
+      {
+         entry_ = tape_value{tape_, entry_, source_}.next_entry();
+         return *this;
+      }
+
+      constexpr iterator operator++(int) noexcept
+      {
+         auto to_ret = *this;
+         ++*this;
+         return to_ret;
+      }
+
+      friend constexpr bool operator==(const iterator& lhs, const iterator& rhs) noexcept
+      {
+         return lhs.entry_ == rhs.entry_;
+      }
+
+   private:
+      const std::uint64_t* tape_ = nullptr;
+      const std::uint64_t* entry_ = nullptr;
+      std::string_view source_;
+   };
+
+   constexpr explicit tape_array(const tape_value& v) noexcept : value_{v} {}
+
+   constexpr iterator begin() const noexcept { return {value_.tape_, value_.entry_ + 1, value_.source_}; }
+   constexpr iterator end() const noexcept { return {value_.tape_, value_.next_entry() - 1, value_.source_}; }
+
+   constexpr std::size_t size() const noexcept
+   {
+      const auto count = impl::payload_of(*value_.entry_) >> 32;
+      return count < impl::count_max ? count : static_cast<std::size_t>(std::ranges::distance(begin(), end()));
+   }
+
+   constexpr bool empty() const noexcept { return begin() == end(); }
+
+   // Linear, as elements aren't fixed size
+   constexpr tape_value operator[](std::size_t index) const
+   {
+      auto iter = begin();
+      for (; index != 0 && iter != end(); --index) {
+         ++iter;
+      }
+      if (iter == end()) {
+         throw std::runtime_error{"array index out of range"};
+      }
+      return *iter;
+   }
+
+private:
+   tape_value value_;
+};
+
+// Mirrors std::get on json_value, e.g., get<tape_map>(value)
+template<typename T>
+constexpr T get(const tape_value& v)
+{
+   if (!v.holds<T>()) {
+      throw std::runtime_error{"JSON value holds a different type"};
+   }
+   if constexpr (std::same_as<T, std::int64_t>) {
+      return static_cast<std::int64_t>(v.entry_[1]);
+   }
+   else if constexpr (std::same_as<T, double>) {
+      return std::bit_cast<double>(v.entry_[1]);
+   }
+   else if constexpr (std::same_as<T, bool>) {
+      return v.tag() == tape_tag::true_value;
+   }
+   else if constexpr (std::same_as<T, std::nullptr_t>) {
+      return nullptr;
+   }
+   else if constexpr (std::same_as<T, std::string_view>) {
+      return v.source_.substr(impl::payload_of(v.entry_[0]), v.entry_[1]);
+   }
+   else {
+      return T{v};
+   }
+}
+
+// Taken by value so these are preferred over the json_map overloads in json_parse.hpp
+constexpr std::optional<tape_value> get_by_key_opt(const tape_map vals, const std::string_view key)
+{
+   for (const auto& [comp_key, value] : vals) {
+      if (comp_key == key) {
+         return value;
+      }
+   }
+   return std::nullopt;
+}
+
+constexpr tape_value get_by_key(const tape_map vals, const std::string_view key)
+{
+   if (const auto val = get_by_key_opt(vals, key)) {
+      return *val;
+   }
+   throw std::runtime_error{"no matching key found"};
+}
+
+// Owns the entries; the source text is only referenced
+class json_tape {
+public:
+   constexpr json_tape() = default;
+
+   constexpr json_tape(std::vector<std::uint64_t> entries, std::string_view source) noexcept
+      : entries_{std::move(entries)}
+      , source_{source}
+   {
+   }
+
+   constexpr tape_value root() const noexcept { return {entries_.data(), entries_.data(), source_}; }
+
+   constexpr const std::vector<std::uint64_t>& entries() const noexcept { return entries_; }
+   constexpr std::string_view source() const noexcept { return source_; }
+
+private:
+   std::vector<std::uint64_t> entries_;
+   std::string_view source_;
+};
+
+namespace impl {
+
+class tape_builder {
+public:
+   constexpr tape_builder(std::string_view source, std::vector<std::uint64_t>& tape) : source_{source}, tape_{tape} {}
+
+   constexpr void on_object_begin() { open(tape_tag::object_begin); }
+   constexpr void on_array_begin() { open(tape_tag::array_begin); }
+   constexpr void on_object_end() { close(tape_tag::object_end); }
+   constexpr void on_array_end() { close(tape_tag::array_end); }
+
+   constexpr void on_key(const std::string_view key) { append_string(key); }
+
+   constexpr void on_string(const std::string_view v)
+   {
+      count_value();
+      append_string(v);
+   }
+
+   constexpr void on_int64(std::int64_t v)
+   {
+      count_value();
+      tape_.push_back(make_entry(tape_tag::int64, 0));
+      tape_.push_back(static_cast<std::uint64_t>(v));
+   }
+
+   constexpr void on_double(double v)
+   {
+      count_value();
+      tape_.push_back(make_entry(tape_tag::double_value, 0));
+      tape_.push_back(std::bit_cast<std::uint64_t>(v));
+   }
+
+   constexpr void on_bool(bool v)
+   {
+      count_value();
+      tape_.push_back(make_entry(v ? tape_tag::true_value : tape_tag::false_value, 0));
+   }
+
+   constexpr void on_null()
+   {
+      count_value();
+      tape_.push_back(make_entry(tape_tag::null_value, 0));
+   }
+
+private:
+   struct open_container {
+      std::size_t begin_index;
+      std::uint64_t count;
+   };
+
+   constexpr void count_value()
+   {
+      if (!open_.empty()) {
+         open_.back().count += 1;
+      }
+   }
+
+   // Strings are views of the source, so only their position is recorded
+   constexpr void append_string(const std::string_view v)
+   {
+      tape_.push_back(make_entry(tape_tag::string, static_cast<std::uint64_t>(v.data() - source_.data())));
+      tape_.push_back(v.size());
+   }
+
+   constexpr void open(tape_tag begin_tag)
+   {
+      count_value();
+      open_.push_back({tape_.size(), 0});
+      tape_.push_back(make_entry(begin_tag, 0));
+   }
+
+   constexpr void close(tape_tag end_tag)
+   {
+      const auto [begin_index, count] = open_.back();
+      open_.pop_back();
+      tape_.push_back(make_entry(end_tag, begin_index));
+      const auto begin_tag = tag_of(tape_[begin_index]);
+      const auto skip = static_cast<std::uint64_t>(tape_.size());
+      tape_[begin_index] = make_entry(begin_tag, skip | (std::min(count, count_max) << 32));
+   }
+
+   std::string_view source_;
+   std::vector<std::uint64_t>& tape_;
+   std::vector<open_container> open_;
+};
+
+} // namespace impl
+
+// Usable both in constant evaluation and at run time
+constexpr json_tape parse_json_tape(const std::string_view v, parse_options options = {})
+{
+   std::vector<std::uint64_t> tape;
+   // Documents mostly come to an entry for every 2 to 8 bytes, so guessing from the size leaves a regrowth or two
+   // at most, without the extra pass over the input that counting its structural characters would take
+   tape.reserve(v.size() / 4);
+   auto builder = impl::tape_builder{v, tape};
+   parse_json_events(v, builder, options);
+   return json_tape{std::move(tape), v};
+}
+
+namespace impl {
+
+template<fixed_string Json>
+inline constexpr std::span<const std::uint64_t> static_tape
+   = ::define_static_array(parse_json_tape(Json.view()).entries());
+
+} // namespace impl
+
+// Parses a literal once per translation unit: the tape is kept in static storage, so every constant evaluation
+// that asks for the same Json shares it instead of parsing the text again
+template<fixed_string Json>
+consteval tape_value parse_json_once() noexcept
+{
+   return {impl::static_tape<Json>.data(), impl::static_tape<Json>.data(), Json.view()};
+}
+
+#endif // JSON_TAPE_HPP
@@ -0,0 +1,285 @@
+#ifndef JSON_WRITE_HPP
+#define JSON_WRITE_HPP
+
+#include "json_out.hpp"
+#include "json_parse.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include <unistd.h>
+
+// Output sink for a FILE* or a file descriptor. Writes are gathered in a fixed buffer and only handed to the OS
+// when it fills up or flush() is called, so arbitrarily large documents can be written with bounded memory.
+class file_sink {
+public:
+   // A buffer_size of 0 is taken as 1, as push_back needs room for at least one character
+   explicit file_sink(std::FILE* file, std::size_t buffer_size = 1 << 16)
+      : file_{file}
+      , buffer_(std::max<std::size_t>(buffer_size, 1))
+   {
+   }
+
+   explicit file_sink(int fd, std::size_t buffer_size = 1 << 16)
+      : fd_{fd}
+      , buffer_(std::max<std::size_t>(buffer_size, 1))
+   {
+   }
+
+   file_sink(const file_sink&) = delete;
+   file_sink& operator=(const file_sink&) = delete;
+
+   // Errors can't be reported from here; call flush() first to see them
+   ~file_sink()
+   {
+      try {
+         flush();
+      }
+      catch (...) {
+      }
+   }
+
+   void append(const std::string_view v)
+   {
+      if (v.empty()) {
+         return;
+      }
+      if (v.size() > buffer_.size() - size_) {
+         flush();
+         // Too big to be worth buffering
+         if (v.size() >= buffer_.size()) {
+            write_out(v);
+            return;
+         }
+      }
+      std::memcpy(buffer_.data() + size_, v.data(), v.size());
+      size_ += v.size();
+   }
+
+   void push_back(char c)
+   {
+      if (size_ == buffer_.size()) {
+         flush();
+      }
+      buffer_[size_] = c;
+      size_ += 1;
+   }
+
+   // Hands everything buffered so far to the OS (and, for a FILE*, flushes the stream as well)
+   void flush()
+   {
+      write_out({buffer_.data(), size_});
+      size_ = 0;
+      if (file_ != nullptr && std::fflush(file_) != 0) {
+         throw std::runtime_error{"error flushing JSON output"};
+      }
+   }
+
+private:
+   void write_out(std::string_view v)
+   {
+      if (file_ != nullptr) {
+         if (std::fwrite(v.data(), 1, v.size(), file_) != v.size()) {
+            throw std::runtime_error{"error writing JSON output"};
+         }
+         return;
+      }
+      while (!v.empty()) {
+         const auto written = ::write(fd_, v.data(), v.size());
+         if (written < 0) {
+            if (errno == EINTR) {
+               continue;
+            }
+            throw std::runtime_error{"error writing JSON output"};
+         }
+         v.remove_prefix(static_cast<std::size_t>(written));
+      }
+   }
+
+   std::FILE* file_ = nullptr;
+   int fd_ = -1;
+   std::vector<char> buffer_;
+   std::size_t size_ = 0;
+};
+
+struct write_options {
+   bool pretty = false;
+   // Spaces per nesting level when pretty printing
+   int indent = 3;
+   // Strings and keys are taken to be as they appear between the quotes of a JSON document, escape sequences
+   // included, and are copied out unchanged instead of escaped. That's how parse_json leaves them without an
+   // arena, so this writes its values, or any part or copy of them, back out as they were read.
+   bool raw_strings = false;
+};
+
+// Streaming writer that takes care of separators and indentation, so documents can be produced piece by piece
+// without ever building a json_value for them
+template<json_output Out>
+class json_writer {
+public:
+   constexpr explicit json_writer(Out& out, write_options options = {}) : out_{out}, options_{options} {}
+
+   constexpr void begin_object() { open('{'); }
+   constexpr void end_object() { close('}'); }
+   constexpr void begin_array() { open('['); }
+   constexpr void end_array() { close(']'); }
+
+   constexpr void key(const std::string_view k)
+   {
+      before_value();
+      string(k);
+      out_.append(options_.pretty ? ": " : ":");
+      after_key_ = true;
+   }
+
+   constexpr void value(std::int64_t v)
+   {
+      before_value();
+      write_json_number(out_, v);
+   }
+
+   // A template so that ints don't convert to it
+   template<std::floating_point Float>
+   constexpr void value(Float v)
+   {
+      before_value();
+      write_json_number(out_, v);
+   }
+
+   // A template so that string literals and ints don't convert to bool
+   template<std::same_as<bool> Bool>
+   constexpr void value(Bool v)
+   {
+      before_value();
+      out_.append(v ? "true" : "false");
+   }
+
+   constexpr void value(std::nullptr_t)
+   {
+      before_value();
+      out_.append("null");
+   }
+
+   constexpr void value(const std::string_view v)
+   {
+      before_value();
+      string(v);
+   }
+
+   constexpr void value(const json_map& v)
+   {
+      begin_object();
+      for (const auto& [k, member] : v) {
+         key(k);
+         value(member);
+      }
+      end_object();
+   }
+
+   constexpr void value(const json_array& v)
+   {
+      begin_array();
+      for (const auto& elem : v) {
+         value(elem);
+      }
+      end_array();
+   }
+
+   // Also a template, otherwise anything convertible to both std::string_view and json_value is ambiguous
+   template<std::same_as<json_value> Value>
+   constexpr void value(const Value& v)
+   {
+      std::visit([&](const auto& alt) { value(alt); }, v);
+   }
+
+private:
+   constexpr void string(const std::string_view v)
+   {
+      if (options_.raw_strings) {
+         out_.push_back('"');
+         out_.append(v);
+         out_.push_back('"');
+      }
+      else {
+         write_json_string(out_, v);
+      }
+   }
+
+   constexpr void newline()
+   {
+      out_.push_back('\n');
+      for (std::size_t i = 0; i < has_items_.size() * static_cast<std::size_t>(options_.indent); ++i) {
+         out_.push_back(' ');
+      }
+   }
+
+   constexpr void before_value()
+   {
+      if (after_key_) {
+         after_key_ = false;
+         return;
+      }
+      if (has_items_.empty()) {
+         return;
+      }
+      if (has_items_.back()) {
+         out_.push_back(',');
+      }
+      has_items_.back() = true;
+      if (options_.pretty) {
+         newline();
+      }
+   }
+
+   constexpr void open(char c)
+   {
+      before_value();
+      out_.push_back(c);
+      has_items_.push_back(false);
+   }
+
+   constexpr void close(char c)
+   {
+      const auto had_items = has_items_.back();
+      has_items_.pop_back();
+      if (options_.pretty && had_items) {
+         newline();
+      }
+      out_.push_back(c);
+   }
+
+   Out& out_;
+   write_options options_;
+   // One entry per open container
+   std::vector<bool> has_items_;
+   bool after_key_ = false;
+};
+
+// Strings are written escaped, so by default they're taken to hold decoded text, as parse_json gives with a
+// json_string_arena. Without one they still contain their escape sequences; write those with
+// options.raw_strings, or their backslashes are escaped again.
+template<typename T>
+   requires(std::same_as<T, json_value> || std::same_as<T, json_map> || std::same_as<T, json_array>)
+constexpr void write_json(const T& v, json_output auto& out, write_options options = {})
+{
+   json_writer writer{out, options};
+   writer.value(v);
+}
+
+constexpr std::string to_json_string(const json_value& v, write_options options = {})
+{
+   std::string to_ret;
+   write_json(v, to_ret, options);
+   return to_ret;
+}
+
+#endif // JSON_WRITE_HPP